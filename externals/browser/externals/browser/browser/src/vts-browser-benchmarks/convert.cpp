@@ -0,0 +1,114 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// coordinates conversion of one metatile worth of points
+//   (32 x 32 nodes, 12 points each) from web mercator,
+//   point by point and as one array
+
+#include <geo/csconvertor.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <vector>
+
+namespace
+{
+
+const char *Mercator = "+proj=merc +a=6378137 +b=6378137 +lat_ts=0.0"
+    " +lon_0=0.0 +x_0=0.0 +y_0=0 +k=1.0 +units=m +nadgrids=@null"
+    " +wktext +no_defs";
+
+const struct
+{
+    const char *name;
+    const char *srs;
+} Targets[] = {
+    { "geocentric", "+proj=geocent +datum=WGS84 +units=m +no_defs" },
+    { "latlon", "+proj=longlat +datum=WGS84 +no_defs" },
+};
+
+template<class F>
+double bestOf(F f)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (int r = 0; r < 20; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+int main()
+{
+    const std::size_t count = 32 * 32 * 12;
+    std::vector<double> source(count * 3);
+    for (std::size_t i = 0; i < count; i++)
+    {
+        source[i * 3 + 0] = -2e7 + 4e7 * (i % 997) / 997.0;
+        source[i * 3 + 1] = -1.5e7 + 3e7 * (i % 991) / 991.0;
+        source[i * 3 + 2] = 100 + i % 500;
+    }
+
+    for (const auto &t : Targets)
+    {
+        geo::CsConvertor cnv(geo::SrsDefinition(Mercator),
+            geo::SrsDefinition(t.srs));
+        std::vector<double> single, batch;
+
+        double singleTime = bestOf([&]() {
+            single = source;
+            for (std::size_t i = 0; i < count; i++)
+            {
+                double *p = single.data() + i * 3;
+                math::Point3 r = cnv(math::Point3(p[0], p[1], p[2]));
+                p[0] = r[0];
+                p[1] = r[1];
+                p[2] = r[2];
+            }
+        });
+
+        double batchTime = bestOf([&]() {
+            batch = source;
+            cnv(batch.data(), count);
+        });
+
+        double diff = 0;
+        for (std::size_t i = 0; i < count * 3; i++)
+            diff = std::max(diff, std::abs(single[i] - batch[i]));
+
+        std::printf("to %s: point by point %.2f ms, batched %.2f ms,"
+            " max difference %g\n", t.name, singleTime, batchTime, diff);
+    }
+    return 0;
+}
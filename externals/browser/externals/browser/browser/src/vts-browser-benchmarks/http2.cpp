@@ -0,0 +1,178 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// time to render of near textures when multiplexed over one http/2
+//   connection together with far textures and metatiles
+//   requested at once, far textures first
+// the server must provide meta0.meta .. meta19.meta (small)
+//   and tex0.jpg .. tex49.jpg (large), eg.:
+//   for i in $(seq 0 19); do head -c 2K /dev/urandom > meta$i.meta; done
+//   for i in $(seq 0 49); do head -c 2M /dev/urandom > tex$i.jpg; done
+//   nghttpd 8443 key.pem cert.pem
+// the fetcher negotiates http/2 with tls only
+//   the certificate must be trusted by the system
+// usage: vts-browser-benchmark-http2 https://localhost:8443/ [equal]
+//   equal: all downloads have the same stream weight
+
+#include <vts-browser/fetcher.hpp>
+#include <vts-browser/log.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+typedef std::chrono::steady_clock Clock;
+
+enum class Kind
+{
+    MetaTile,
+    NearTexture,
+    FarTexture,
+};
+
+std::mutex mut;
+std::condition_variable con;
+uint32 remaining = 0;
+Clock::time_point start;
+
+class Task : public vts::FetchTask
+{
+public:
+    Task(const Query &query, Kind kind) : FetchTask(query), kind(kind)
+    {}
+
+    void fetchDone() override
+    {
+        done = std::chrono::duration<double, std::milli>(
+            Clock::now() - start).count();
+        if (reply.code != 200)
+            std::printf("<%s> failed with code %u\n",
+                query.url.c_str(), reply.code);
+        std::lock_guard<std::mutex> lock(mut);
+        remaining--;
+        con.notify_all();
+    }
+
+    const Kind kind;
+    double done = 0; // ms
+};
+
+void waitAll()
+{
+    std::unique_lock<std::mutex> lock(mut);
+    while (remaining > 0)
+        con.wait(lock);
+}
+
+vts::FetchTask::Query query(const std::string &url,
+    vts::FetchTask::ResourceType type, float priority, bool equal)
+{
+    // undefined resources with no priority get the default weight
+    vts::FetchTask::Query q(url, equal
+        ? vts::FetchTask::ResourceType::Undefined : type);
+    q.priority = equal ? 0 : priority;
+    return q;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::printf("usage: %s <url prefix> [equal]\n", argv[0]);
+        return 1;
+    }
+    vts::setLogMask("W");
+    const std::string prefix = argv[1];
+    const bool equal = argc > 2 && std::string(argv[2]) == "equal";
+    const uint32 runs = 10;
+
+    vts::FetcherOptions options;
+    options.threads = 1;
+    options.maxHostConnections = 1;
+    options.compression = false;
+    std::shared_ptr<vts::Fetcher> fetcher = vts::Fetcher::create(options);
+    fetcher->initialize();
+
+    double sums[3] = { 0, 0, 0 }; // metatiles, near textures, all
+    for (uint32 run = 0; run < runs; run++)
+    {
+        // establish the connection
+        {
+            remaining = 1;
+            fetcher->fetch(std::make_shared<Task>(vts::FetchTask::Query(
+                prefix + "meta0.meta", vts::FetchTask::ResourceType::MetaTile),
+                Kind::MetaTile));
+            waitAll();
+        }
+
+        // stream weights: far textures 32, near textures 160, metatiles 256
+        std::vector<std::shared_ptr<Task>> tasks;
+        for (uint32 i = 0; i < 40; i++)
+            tasks.push_back(std::make_shared<Task>(query(prefix + "tex"
+                + std::to_string(i + 10) + ".jpg",
+                vts::FetchTask::ResourceType::Texture, 1, equal),
+                Kind::FarTexture));
+        for (uint32 i = 0; i < 10; i++)
+            tasks.push_back(std::make_shared<Task>(query(prefix + "tex"
+                + std::to_string(i) + ".jpg",
+                vts::FetchTask::ResourceType::Texture, 1e4, equal),
+                Kind::NearTexture));
+        for (uint32 i = 0; i < 20; i++)
+            tasks.push_back(std::make_shared<Task>(query(prefix + "meta"
+                + std::to_string(i) + ".meta",
+                vts::FetchTask::ResourceType::MetaTile, 2e4, equal),
+                Kind::MetaTile));
+
+        remaining = tasks.size();
+        start = Clock::now();
+        for (auto &t : tasks)
+            fetcher->fetch(t);
+        waitAll();
+
+        double times[3] = { 0, 0, 0 };
+        for (auto &t : tasks)
+            times[(int)t->kind] = std::max(times[(int)t->kind], t->done);
+        sums[0] += times[(int)Kind::MetaTile];
+        sums[1] += times[(int)Kind::NearTexture];
+        sums[2] += *std::max_element(times, times + 3);
+    }
+    fetcher->finalize();
+
+    std::printf("%s: metatiles %.1f ms, near textures %.1f ms, "
+        "all %.1f ms (mean of %u runs)\n",
+        equal ? "equal" : "weighted", sums[0] / runs, sums[1] / runs,
+        sums[2] / runs, runs);
+    return 0;
+}
@@ -0,0 +1,344 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// decoding of vts meshes (version 3) into the gpu layout
+//   the generic path loads vtslibs submeshes and converts them
+//   the direct path decodes the buffer in a single pass
+// the meshes are synthetic grids, the results are compared byte by byte
+
+#include <vts-browser/buffer.hpp>
+#include <vts-browser/math.hpp>
+#include <vts-libs/vts/meshio.hpp>
+
+#include "utilities/meshV3.hpp"
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace vts
+{
+
+namespace
+{
+
+// copy of the generic conversion in GpuMesh
+GpuMeshSpec convertGeneric(const vtslibs::vts::SubMesh &m)
+{
+    GpuMeshSpec spec;
+    const uint32 vertexSize = surfaceMeshLayout(spec,
+        !m.tc.empty(), !m.etc.empty());
+    if (m.tc.empty())
+    {
+        spec.verticesCount = m.vertices.size();
+        spec.vertices.allocate(spec.verticesCount * vertexSize);
+        spec.indicesCount = m.faces.size() * 3;
+        spec.indices.allocate(spec.indicesCount * sizeof(uint16));
+        uint16 *io = (uint16*)spec.indices.data();
+        for (const auto &it : m.faces)
+            for (uint32 j = 0; j < 3; j++)
+                *io++ = it[j];
+        char *ps = spec.vertices.data() + spec.attributes[0].offset;
+        char *es = spec.vertices.data() + spec.attributes[2].offset;
+        for (uint32 i = 0, e = m.vertices.size(); i < e; i++)
+        {
+            vec3 v = vecFromUblas<vec3>(m.vertices[i]);
+            *(vec3f*)(ps + i * vertexSize) = v.cast<float>();
+            if (spec.attributes[2].enable)
+                *(vec2ui16*)(es + i * vertexSize)
+                    = vec2to2ui16(vecFromUblas<vec2f>(m.etc[i]));
+        }
+    }
+    else
+    {
+        spec.verticesCount = m.tc.size();
+        spec.vertices.allocate(spec.verticesCount * vertexSize);
+        spec.indicesCount = m.facesTc.size() * 3;
+        spec.indices.allocate(spec.indicesCount * sizeof(uint16));
+        uint16 *io = (uint16*)spec.indices.data();
+        for (const auto &it : m.facesTc)
+            for (uint32 j = 0; j < 3; j++)
+                *io++ = it[j];
+        char *ps = spec.vertices.data() + spec.attributes[0].offset;
+        char *is = spec.vertices.data() + spec.attributes[1].offset;
+        char *es = spec.vertices.data() + spec.attributes[2].offset;
+        for (uint32 fi = 0, fc = m.facesTc.size(); fi != fc; fi++)
+        {
+            for (uint32 vi = 0; vi < 3; vi++)
+            {
+                uint32 oi = m.facesTc[fi][vi];
+                uint32 ii = m.faces[fi][vi];
+                vec3 v = vecFromUblas<vec3>(m.vertices[ii]);
+                *(vec3f*)(ps + oi * vertexSize) = v.cast<float>();
+                *(vec2ui16*)(is + oi * vertexSize)
+                    = vec2to2ui16(vecFromUblas<vec2f>(m.tc[oi]));
+                if (spec.attributes[2].enable)
+                    *(vec2ui16*)(es + oi * vertexSize)
+                        = vec2to2ui16(vecFromUblas<vec2f>(m.etc[ii]));
+            }
+        }
+    }
+    return spec;
+}
+
+// writes the mesh stream the same way as vtslibs saveMeshVersion3
+class MeshWriter
+{
+public:
+    template<class T>
+    void put(T v)
+    {
+        data.append((const char*)&v, sizeof(T));
+    }
+
+    void word(uint32 w)
+    {
+        if (w < 0x80)
+            put<uint8>(w);
+        else
+        {
+            put<uint8>((w & 0x7f) | 0x80);
+            put<uint8>(w >> 7);
+        }
+    }
+
+    void delta(sint32 v, sint32 &last)
+    {
+        sint32 d = v - last;
+        last = v;
+        word((d << 1) ^ (d >> 31));
+    }
+
+    // new indices must be introduced in increasing order
+    void index(sint32 v, sint32 &high)
+    {
+        sint32 d = high - v;
+        if (d == 0)
+            high++;
+        word(d);
+    }
+
+    std::string data;
+};
+
+// grid of size x size vertices in each submesh
+std::string makeMesh(std::mt19937 &rnd, uint32 submeshes, uint32 size,
+    bool internalUv, bool externalUv)
+{
+    MeshWriter w;
+    w.data = "ME";
+    w.put<uint16>(3); // version
+    w.put<double>(0); // mean undulation
+    w.put<uint16>(submeshes);
+    for (uint32 sm = 0; sm < submeshes; sm++)
+    {
+        w.put<uint8>((internalUv ? 1 : 0) | (externalUv ? 2 : 0)
+            | (sm % 2 ? 8 : 0)); // flags
+        w.put<uint8>(sm); // surface reference
+        w.put<uint16>(sm); // texture layer
+        const double bbox[6] = { -1000, -2000, 100, 1000, 2000, 400 };
+        for (double d : bbox)
+            w.put(d);
+
+        const uint32 count = size * size;
+        std::uniform_int_distribution<sint32> jitter(-3, 3);
+        std::vector<std::array<sint32, 3>> positions(count);
+        std::vector<std::array<sint32, 2>> uvs(count), tcs(count);
+        for (uint32 y = 0; y < size; y++)
+        {
+            for (uint32 x = 0; x < size; x++)
+            {
+                uint32 i = y * size + x;
+                positions[i] = {{ sint32(x * 4096 / size) - 2048
+                    + jitter(rnd), sint32(y * 4096 / size) - 2048
+                    + jitter(rnd), jitter(rnd) * 50 }};
+                uvs[i] = {{ sint32(x * 4095 / (size - 1)),
+                    sint32(y * 4095 / (size - 1)) }};
+                tcs[i] = {{ sint32(x * 2047 / (size - 1)),
+                    2047 - sint32(y * 2047 / (size - 1)) }};
+            }
+        }
+        std::vector<uint32> faces;
+        for (uint32 y = 0; y + 1 < size; y++)
+        {
+            for (uint32 x = 0; x + 1 < size; x++)
+            {
+                uint32 a = y * size + x, b = a + 1;
+                uint32 c = a + size, d = c + 1;
+                faces.insert(faces.end(), { a, b, c, b, d, c });
+            }
+        }
+
+        // vertices are stored in the order of their first use
+        std::vector<sint32> order(count, -1);
+        std::vector<uint32> vertices;
+        for (uint32 f : faces)
+        {
+            if (order[f] < 0)
+            {
+                order[f] = vertices.size();
+                vertices.push_back(f);
+            }
+        }
+
+        w.put<uint16>(count);
+        w.put<uint16>(1024); // geometry quantization
+        sint32 last[3] = { 0, 0, 0 };
+        for (uint32 i : vertices)
+            for (uint32 k = 0; k < 3; k++)
+                w.delta(positions[i][k], last[k]);
+        if (externalUv)
+        {
+            w.put<uint16>(4096); // quantization
+            sint32 l[2] = { 0, 0 };
+            for (uint32 i : vertices)
+                for (uint32 k = 0; k < 2; k++)
+                    w.delta(uvs[i][k], l[k]);
+        }
+        if (internalUv)
+        {
+            w.put<uint16>(count);
+            w.put<uint16>(2048); // quantization
+            w.put<uint16>(2048);
+            sint32 l[2] = { 0, 0 };
+            for (uint32 i : vertices)
+                for (uint32 k = 0; k < 2; k++)
+                    w.delta(tcs[i][k], l[k]);
+        }
+        w.put<uint16>(faces.size() / 3);
+        sint32 high = 0;
+        for (uint32 f : faces)
+            w.index(order[f], high);
+        if (internalUv)
+        {
+            high = 0;
+            for (uint32 f : faces)
+                w.index(order[f], high);
+        }
+    }
+    return w.data;
+}
+
+bool sameSpec(const GpuMeshSpec &a, const GpuMeshSpec &b)
+{
+    if (a.verticesCount != b.verticesCount
+        || a.indicesCount != b.indicesCount
+        || a.vertices.size() != b.vertices.size()
+        || a.indices.size() != b.indices.size()
+        || memcmp(a.vertices.data(), b.vertices.data(), a.vertices.size())
+        || memcmp(a.indices.data(), b.indices.data(), a.indices.size()))
+        return false;
+    for (uint32 i = 0; i < 4; i++)
+    {
+        const auto &x = a.attributes[i], &y = b.attributes[i];
+        if (x.enable != y.enable || x.type != y.type
+            || x.offset != y.offset || x.stride != y.stride)
+            return false;
+    }
+    return true;
+}
+
+bool sameResult(const Buffer &buffer)
+{
+    std::vector<MeshV3Part> parts;
+    if (!decodeMeshV3(buffer, parts))
+        return false;
+    detail::BufferStream s(buffer);
+    auto meshes = vtslibs::vts::loadMeshProperNormalized(s, "benchmark");
+    if (meshes.size() != parts.size())
+        return false;
+    for (uint32 i = 0; i < parts.size(); i++)
+    {
+        const auto &m = meshes[i];
+        const MeshV3Part &p = parts[i];
+        if (!sameSpec(convertGeneric(m.submesh), p.spec)
+            || p.extents.ll != m.extents.ll || p.extents.ur != m.extents.ur
+            || p.surfaceReference != m.submesh.surfaceReference
+            || p.textureLayer != (m.submesh.textureLayer
+                ? *m.submesh.textureLayer : 0u))
+            return false;
+    }
+    return true;
+}
+
+template<class F>
+double microseconds(F f, uint32 runs)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (uint32 r = 0; r < runs; r++)
+        f();
+    return std::chrono::duration<double, std::micro>(
+        std::chrono::steady_clock::now() - start).count() / runs;
+}
+
+} // namespace
+
+} // namespace vts
+
+using namespace vts;
+
+int main()
+{
+    const struct
+    {
+        const char *name;
+        bool internalUv;
+        bool externalUv;
+    } cases[] = {
+        { "internal uv", true, false },
+        { "internal+external uv", true, true },
+        { "external uv", false, true },
+    };
+    const uint32 runs = 300;
+    std::mt19937 rnd(42);
+    for (const auto &c : cases)
+    {
+        const Buffer buffer(makeMesh(rnd, 2, 64, c.internalUv, c.externalUv));
+        const bool same = sameResult(buffer);
+
+        double generic = microseconds([&]() {
+            detail::BufferStream s(buffer);
+            auto meshes = vtslibs::vts::loadMeshProperNormalized(s,
+                "benchmark");
+            for (const auto &m : meshes)
+                convertGeneric(m.submesh);
+        }, runs);
+
+        double direct = microseconds([&]() {
+            std::vector<MeshV3Part> parts;
+            decodeMeshV3(buffer, parts);
+        }, runs);
+
+        std::printf("%-22s %7u bytes: generic %7.1f us, direct %6.1f us,"
+            " %4.1fx, identical: %s\n", c.name, buffer.size(),
+            generic, direct, generic / direct, same ? "yes" : "NO");
+        if (!same)
+            return 1;
+    }
+    return 0;
+}
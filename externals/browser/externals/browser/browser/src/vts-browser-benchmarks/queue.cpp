@@ -0,0 +1,120 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// compares the fifo and priority queues used by the resources manager
+//   pushes all items and then pops them, best of several runs
+
+#include "include/vts-browser/foundation.hpp"
+#include "utilities/threadQueue.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <random>
+
+namespace vts
+{
+
+namespace
+{
+
+struct Item
+{
+    float priority;
+};
+
+typedef std::weak_ptr<Item> ItemRef;
+
+bool threadQueuePriority(const ItemRef &ref, float &priority)
+{
+    auto it = ref.lock();
+    if (!it)
+        return false;
+    priority = it->priority;
+    return true;
+}
+
+template<class F>
+double bestOf(F f)
+{
+    double best = std::numeric_limits<double>::infinity();
+    for (uint32 r = 0; r < 5; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        best = std::min(best, std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+}
+
+} // namespace
+
+} // namespace vts
+
+using namespace vts;
+
+int main()
+{
+    std::printf("   items   ThreadQueue   ThreadPriorityQueue"
+        "   reprioritize()\n");
+    for (uint32 n : { 1000, 10000, 50000 })
+    {
+        std::mt19937 rnd(42);
+        std::vector<std::shared_ptr<Item>> items(n);
+        for (auto &it : items)
+            it = std::make_shared<Item>(Item{ float(rnd() % 1000) });
+
+        double fifo = bestOf([&]() {
+            ThreadQueue<ItemRef> q;
+            for (auto &it : items)
+                q.push(it);
+            ItemRef r;
+            while (q.tryPop(r));
+        });
+
+        double heap = bestOf([&]() {
+            ThreadPriorityQueue<ItemRef> q;
+            for (auto &it : items)
+                q.push(it);
+            ItemRef r;
+            while (q.tryPop(r));
+        });
+
+        ThreadPriorityQueue<ItemRef> q;
+        for (auto &it : items)
+            q.push(it);
+        double rep = bestOf([&]() {
+            for (auto &it : items)
+                it->priority = float(rnd() % 1000);
+            q.reprioritize();
+        });
+
+        std::printf("%8u   %8.2f ms          %8.2f ms      %8.2f ms\n",
+            n, fifo, heap, rep);
+    }
+    return 0;
+}
@@ -1118,6 +1118,8 @@ public:
                 S("Node draw updates:", cs.currentNodeDrawsUpdates, "");
                 S("Preparing:", ms.resourcesPreparing, "");
                 S("Downloading:", ms.resourcesDownloading, "");
+                S("Downloads limit:", ms.resourcesDownloadsLimit, "");
+                S("Bandwidth:", ms.downloadBandwidth / 1024, " KB/s");
 
                 if (nk_tree_push(&ctx, NK_TREE_TAB, "Queues",
                     NK_MINIMIZED))
@@ -1144,11 +1146,42 @@ public:
                     S("Active:", ms.resourcesActive, "");
                     S("Downloaded:", ms.resourcesDownloaded, "");
                     S("Disk loaded:", ms.resourcesDiskLoaded, "");
+                    S("Local loaded:", ms.resourcesLocalLoaded, "");
                     S("Decoded:", ms.resourcesDecoded, "");
                     S("Uploaded:", ms.resourcesUploaded, "");
                     S("Created:", ms.resourcesCreated, "");
                     S("Released:", ms.resourcesReleased, "");
                     S("Failed:", ms.resourcesFailed, "");
+                    S("Cancelled:", ms.resourcesCancelled, "");
+                    S("Revalidated:", ms.resourcesRevalidated, "");
+                    {
+                        uint64 transferred = 0, decoded = 0;
+                        for (uint32 i = 0; i < FetchTask::ResourceTypesCount;
+                            i++)
+                        {
+                            transferred += ms.downloadedBytesTransferred[i];
+                            decoded += ms.downloadedBytesDecoded[i];
+                        }
+                        S("Transferred:", transferred / 1024 / 1024, " MB");
+                        S("Decoded:", decoded / 1024 / 1024, " MB");
+                    }
+
+                    nk_tree_pop(&ctx);
+                }
+
+                if (nk_tree_push(&ctx, NK_TREE_TAB, "Disk cache",
+                    NK_MINIMIZED))
+                {
+                    float ratio2[] = { width * 0.45f, width * 0.45f };
+                    nk_layout_row(&ctx, NK_STATIC, 16, 2, ratio2);
+
+                    S("Size:", ms.diskCacheSizeKB / 1024, " MB");
+                    S("Evictions:", ms.diskCacheEvictions, "");
+                    S("Hits:", ms.diskCacheHits, "");
+                    S("Misses:", ms.diskCacheMisses, "");
+                    S("Hit rate:", uint32(ms.diskCacheHitRate * 100), " %");
+                    S("Missing:", ms.diskCacheNegativeEntries, "");
+                    S("Missing hits:", ms.diskCacheNegativeHits, "");
 
                     nk_tree_pop(&ctx);
                 }
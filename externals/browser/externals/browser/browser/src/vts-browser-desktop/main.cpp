@@ -148,8 +148,16 @@ int main(int argc, char *argv[])
 
         // vts map and main loop entry
         {
-            vts::Map map(createOptions,
-                vts::Fetcher::create(fetcherOptions));
+            std::shared_ptr<vts::Fetcher> fetcher;
+            if (!appOptions.replayDownloads.empty())
+                fetcher = vts::Fetcher::createReplay(
+                    appOptions.replayDownloads, appOptions.replayTimeScale);
+            else
+                fetcher = vts::Fetcher::create(fetcherOptions);
+            if (!appOptions.recordDownloads.empty())
+                fetcher = vts::Fetcher::createRecorder(fetcher,
+                    appOptions.recordDownloads);
+            vts::Map map(createOptions, fetcher);
             auto camera = map.createCamera();
             auto navigation = camera->createNavigation();
             map.options() = mapOptions;
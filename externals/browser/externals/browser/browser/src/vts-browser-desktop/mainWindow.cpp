@@ -66,6 +66,7 @@ void windowSwap(SDL_Window *window)
 } // namespace
 
 AppOptions::AppOptions() :
+    replayTimeScale(0),
     oversampleRender(1),
     renderCompas(0),
     simulatedFpsSlowdown(0),
@@ -67,6 +67,9 @@ struct AppOptions
 {
     std::vector<MapPaths> paths;
     std::string initialPosition;
+    std::string recordDownloads;
+    std::string replayDownloads;
+    double replayTimeScale;
     uint32 oversampleRender;
     int renderCompas;
     int simulatedFpsSlowdown;
@@ -76,6 +76,21 @@ bool programOptions(vts::MapCreateOptions &createOptions,
                 "Uses url format, eg.:\n"
                 "obj,long,lat,fix,height,pitch,yaw,roll,extent,fov"
             )
+            ("recordDownloads",
+                po::value<std::string>(&appOptions.recordDownloads),
+                "Record all downloads into the archive file."
+            )
+            ("replayDownloads",
+                po::value<std::string>(&appOptions.replayDownloads),
+                "Serve all downloads from the archive file, "
+                "no network is used."
+            )
+            ("replayTimeScale",
+                po::value<double>(&appOptions.replayTimeScale)
+                ->default_value(appOptions.replayTimeScale),
+                "Multiplier of the recorded durations of the downloads, "
+                "0 = reply immediately."
+            )
             ("purgeCache",
                 po::value<bool>(&appOptions.purgeDiskCache)
                 ->default_value(appOptions.purgeDiskCache)
@@ -418,6 +418,12 @@ namespace vts
         [DllImport(LibName, CallingConvention = CallingConvention.Cdecl)]
         public static extern void vtsTextureGetBuffer(IntPtr resource, ref IntPtr data, ref uint size);
 
+        [DllImport(LibName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern uint vtsTextureGetMipmapsCount(IntPtr resource);
+
+        [DllImport(LibName, CallingConvention = CallingConvention.Cdecl)]
+        public static extern void vtsTextureGetMipmapBuffer(IntPtr resource, uint index, ref IntPtr data, ref uint size);
+
         [DllImport(LibName, CallingConvention = CallingConvention.Cdecl)]
         public static extern uint vtsMeshGetFaceMode(IntPtr resource);
 
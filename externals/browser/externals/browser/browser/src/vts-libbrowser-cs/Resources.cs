@@ -80,9 +80,11 @@ namespace vts
         public uint height;
         public uint components;
         public GpuType type;
+        public uint internalFormat; // nonzero for block compressed textures
         public FilterMode filterMode;
         public WrapMode wrapMode;
         public byte[] data;
+        public byte[][] mipmaps; // levels 1, 2, ...; empty if not generated
         public string id;
 
         public void Load(IntPtr handle)
@@ -92,6 +94,8 @@ namespace vts
             Util.CheckInterop();
             type = (GpuType)BrowserInterop.vtsTextureGetType(handle);
             Util.CheckInterop();
+            internalFormat = BrowserInterop.vtsTextureGetInternalFormat(handle);
+            Util.CheckInterop();
             filterMode = (FilterMode)BrowserInterop.vtsTextureGetFilterMode(handle);
             Util.CheckInterop();
             wrapMode = (WrapMode)BrowserInterop.vtsTextureGetWrapMode(handle);
@@ -102,6 +106,16 @@ namespace vts
             Util.CheckInterop();
             data = new byte[bufSize];
             Marshal.Copy(bufPtr, data, 0, (int)bufSize);
+            uint levels = BrowserInterop.vtsTextureGetMipmapsCount(handle);
+            Util.CheckInterop();
+            mipmaps = new byte[levels][];
+            for (uint i = 0; i < levels; i++)
+            {
+                BrowserInterop.vtsTextureGetMipmapBuffer(handle, i, ref bufPtr, ref bufSize);
+                Util.CheckInterop();
+                mipmaps[i] = new byte[bufSize];
+                Marshal.Copy(bufPtr, mipmaps[i], 0, (int)bufSize);
+            }
         }
     }
 
@@ -107,11 +107,62 @@ void optionsConfigMapCreate(
         po::value<std::string>(&opts->cachePath),
         "Path to a directory where all downloaded resources are cached.")
 
+    ((section + "localTilesetsPath").c_str(),
+        po::value<std::string>(&opts->localTilesetsPath),
+        "Path to a directory with tilesets to read instead of downloading.")
+
+    ((section + "decodeThreads").c_str(),
+        po::value<uint32>(&opts->decodeThreads),
+        "Number of threads for decoding resources, 0 = automatic.")
+
+    ((section + "cacheReadThreads").c_str(),
+        po::value<uint32>(&opts->cacheReadThreads),
+        "Number of threads reading from the disk cache concurrently.")
+
+    ((section + "diskCacheMaxSizeMB").c_str(),
+        po::value<uint32>(&opts->diskCacheMaxSizeMB),
+        "Maximum size of the disk cache, 0 = unlimited.")
+
+    ((section + "negativeCacheExpiration").c_str(),
+        po::value<uint32>(&opts->negativeCacheExpiration),
+        "Seconds to remember resources missing on the server, 0 = never.")
+
+    ((section + "textureComponents").c_str(),
+        po::value<uint32>(&opts->textureComponents),
+        "Expand decoded textures to this many channels, 0 = keep.")
+
+    ((section + "boundTexturesMinResolution").c_str(),
+        po::value<uint32>(&opts->boundTexturesMinResolution),
+        "Downscale jpeg bound layer textures while decoding "
+        "down to this resolution, 0 = full resolution.")
+
+    ((section + "textureCompression").c_str(),
+        po::value<TextureCompression>(&opts->textureCompression),
+        "Block compression of surface and bound layer textures:\n"
+        "none\n"
+        "bc\n"
+        "etc2")
+
     ((section + "diskCache").c_str(),
         po::value<bool>(&opts->diskCache)
         ->implicit_value(!opts->diskCache),
         "Use disk cache.")
 
+    ((section + "packedDiskCache").c_str(),
+        po::value<bool>(&opts->packedDiskCache)
+        ->implicit_value(!opts->packedDiskCache),
+        "Store the disk cache in few large memory mapped files.")
+
+    ((section + "cacheReadAhead").c_str(),
+        po::value<bool>(&opts->cacheReadAhead)
+        ->implicit_value(!opts->cacheReadAhead),
+        "Read ahead child metatiles and sibling textures from the disk cache.")
+
+    ((section + "textureMipmaps").c_str(),
+        po::value<bool>(&opts->textureMipmaps)
+        ->implicit_value(!opts->textureMipmaps),
+        "Generate mipmaps of textures on the decode threads.")
+
     FILE_OPTIONS;
 }
 
@@ -133,10 +184,30 @@ void optionsConfigMapRuntime(
         "Target memory (in KB) used by resources "
         "before they begin to unload.")
 
+    ((section + "targetGpuMemoryKB").c_str(),
+        po::value<uint32>(&opts->targetGpuMemoryKB),
+        "Target gpu memory (in KB) used by resources "
+        "before they begin to unload, 0 = no separate limit.")
+
+    ((section + "targetRamMemoryKB").c_str(),
+        po::value<uint32>(&opts->targetRamMemoryKB),
+        "Target ram memory (in KB) used by resources "
+        "before they begin to unload, 0 = no separate limit.")
+
     ((section + "maxConcurrentDownloads").c_str(),
         po::value<uint32>(&opts->maxConcurrentDownloads),
         "Maximum size of the queue for the resources to be downloaded.")
 
+    ((section + "maxAdaptiveConcurrentDownloads").c_str(),
+        po::value<uint32>(&opts->maxAdaptiveConcurrentDownloads),
+        "Upper bound for the adaptive limit of downloads for each host.")
+
+    ((section + "adaptiveConcurrentDownloads").c_str(),
+        po::value<bool>(&opts->adaptiveConcurrentDownloads)
+        ->implicit_value(!opts->adaptiveConcurrentDownloads),
+        "Tune the number of concurrent downloads for each host "
+        "from the observed latency and throughput.")
+
     ((section + "maxFetchRedirections").c_str(),
         po::value<uint32>(&opts->maxFetchRedirections),
         "Maximum number of redirections before the download fails.")
@@ -149,6 +220,10 @@ void optionsConfigMapRuntime(
         po::value<uint32>(&opts->fetchFirstRetryTimeOffset),
         "Delay in seconds for first resource download retry.")
 
+    ((section + "cancelDownloadsAfterTicks").c_str(),
+        po::value<uint32>(&opts->cancelDownloadsAfterTicks),
+        "Cancel downloads of resources not accessed for this many ticks.")
+
     ((section + "debugSaveCorruptedFiles").c_str(),
         po::value<bool>(&opts->debugSaveCorruptedFiles)
         ->implicit_value(!opts->debugSaveCorruptedFiles),
@@ -268,6 +343,11 @@ void optionsConfigFetcherOptions(
         po::value<sint32>(&opts->pipelining),
         "HTTP pipelining mode.")
 
+    ((section + "compression").c_str(),
+        po::value<bool>(&opts->compression)
+        ->implicit_value(!opts->compression),
+        "Request compressed transfers.")
+
     ((section + "extraFileLog").c_str(),
         po::value<bool>(&opts->extraFileLog)
         ->implicit_value(!opts->extraFileLog),
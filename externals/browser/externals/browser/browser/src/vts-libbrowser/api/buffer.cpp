@@ -35,6 +35,7 @@
 #include <boost/filesystem.hpp>
 #include <dbglog/dbglog.hpp>
 
+#include <algorithm>
 #include <cstring>
 #include <map>
 
@@ -106,7 +107,8 @@ Buffer::~Buffer()
     this->free();
 }
 
-Buffer::Buffer(Buffer &&other) noexcept : data_(other.data_), size_(other.size_)
+Buffer::Buffer(Buffer &&other) noexcept : data_(other.data_), size_(other.size_),
+    owner_(std::move(other.owner_))
 {
     other.data_ = nullptr;
     other.size_ = 0;
@@ -118,6 +120,7 @@ Buffer &Buffer::operator = (Buffer &&other) noexcept
     this->free();
     size_ = other.size_;
     data_ = other.data_;
+    owner_ = std::move(other.owner_);
     other.data_ = nullptr;
     other.size_ = 0;
     return *this;
@@ -130,6 +133,29 @@ Buffer Buffer::copy() const
     return r;
 }
 
+Buffer Buffer::wrap(const char *data, uint32 size,
+    const std::shared_ptr<const void> &owner)
+{
+    assert(owner);
+    Buffer r;
+    r.data_ = const_cast<char*>(data);
+    r.size_ = size;
+    r.owner_ = owner;
+    return r;
+}
+
+Buffer Buffer::share()
+{
+    if (!data_)
+        return Buffer();
+    if (!owner_)
+    {
+        owner_ = std::shared_ptr<const void>(data_,
+            [](char *p) { ::free(p); });
+    }
+    return wrap(data_, size_, owner_);
+}
+
 std::string Buffer::str() const
 {
     return std::string(data_, size_);
@@ -148,6 +174,14 @@ void Buffer::allocate(uint32 size)
 
 void Buffer::resize(uint32 size)
 {
+    if (owner_)
+    {
+        // wrapped memory cannot be reallocated, make own copy
+        Buffer r(size);
+        memcpy(r.data_, data_, std::min(size, size_));
+        *this = std::move(r);
+        return;
+    }
     char *tmp = (char*)realloc(data_, size);
     if (!tmp)
     {
@@ -166,35 +200,17 @@ void Buffer::zero()
 
 void Buffer::free()
 {
-    ::free(data_);
+    if (owner_)
+        owner_.reset();
+    else
+        ::free(data_);
     data_ = nullptr;
     size_ = 0;
 }
 
 void writeLocalFileBuffer(const std::string &path, const Buffer &buffer)
 {
-    std::string folderPath = boost::filesystem::path(path)
-            .parent_path().string();
-    if (!folderPath.empty())
-        boost::filesystem::create_directories(folderPath);
-    std::string tmpPath = path + "_tmp_" + uniqueName();
-    FILE *f = fopen(tmpPath.c_str(), "wb");
-    if (!f)
-        LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
-                                           << path << ">";
-    if (buffer.size() > 0)
-    {
-        if (fwrite(buffer.data(), buffer.size(), 1, f) != 1)
-        {
-            fclose(f);
-            LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
-                                               << path << ">";
-        }
-    }
-    if (fclose(f) != 0)
-        LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
-                                           << path << ">";
-    boost::filesystem::rename(tmpPath, path);
+    detail::writeLocalFileParts(path, { { buffer.data(), buffer.size() } });
 }
 
 Buffer readLocalFileBuffer(const std::string &path)
@@ -235,6 +251,35 @@ Buffer readInternalMemoryBuffer(const std::string &path)
 namespace detail
 {
 
+void writeLocalFileParts(const std::string &path,
+    const std::vector<std::pair<const void *, uint32>> &parts)
+{
+    std::string folderPath = boost::filesystem::path(path)
+            .parent_path().string();
+    if (!folderPath.empty())
+        boost::filesystem::create_directories(folderPath);
+    std::string tmpPath = path + "_tmp_" + uniqueName();
+    FILE *f = fopen(tmpPath.c_str(), "wb");
+    if (!f)
+        LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
+                                           << path << ">";
+    for (const auto &it : parts)
+    {
+        if (it.second == 0)
+            continue;
+        if (fwrite(it.first, it.second, 1, f) != 1)
+        {
+            fclose(f);
+            LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
+                                               << path << ">";
+        }
+    }
+    if (fclose(f) != 0)
+        LOGTHROW(err1, std::runtime_error) << "Failed to write file <"
+                                           << path << ">";
+    boost::filesystem::rename(tmpPath, path);
+}
+
 BufferStream::BufferStream(const Buffer &b) : std::istream(this)
 {
     setg(b.data(), b.data(), b.data() + b.size());
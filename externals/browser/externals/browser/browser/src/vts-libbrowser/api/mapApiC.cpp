@@ -1029,6 +1029,24 @@ void vtsTextureGetBuffer(vtsHResource resource,
     C_END
 }
 
+uint32 vtsTextureGetMipmapsCount(vtsHResource resource)
+{
+    C_BEGIN
+    return resource->ptr.t->mipmaps.size();
+    C_END
+    return 0;
+}
+
+void vtsTextureGetMipmapBuffer(vtsHResource resource, uint32 index,
+        void **data, uint32 *size)
+{
+    C_BEGIN
+    vts::Buffer &b = resource->ptr.t->mipmaps.at(index);
+    *data = b.data();
+    *size = b.size();
+    C_END
+}
+
 uint32 vtsMeshGetFaceMode(vtsHResource resource)
 {
     C_BEGIN
@@ -61,13 +61,24 @@ void MapCreateOptions::applyJson(const std::string &json)
     Json::Value v = stringToJson(json);
     AJ(clientId, asString);
     AJ(cachePath, asString);
+    AJ(localTilesetsPath, asString);
     AJ(geodataFontFallback, asString);
     AJ(searchUrlFallback, asString);
     AJ(searchSrsFallback, asString);
     AJ(customSrs1, asString);
     AJ(customSrs2, asString);
+    AJ(decodeThreads, asUInt);
+    AJ(cacheReadThreads, asUInt);
+    AJ(diskCacheMaxSizeMB, asUInt);
+    AJ(negativeCacheExpiration, asUInt);
+    AJ(textureComponents, asUInt);
+    AJ(boundTexturesMinResolution, asUInt);
+    AJE(textureCompression, TextureCompression);
     AJ(diskCache, asBool);
     AJ(hashCachePaths, asBool);
+    AJ(packedDiskCache, asBool);
+    AJ(cacheReadAhead, asBool);
+    AJ(textureMipmaps, asBool);
     AJ(searchUrlFallbackOutsideEarth, asBool);
     AJ(browserOptionsSearchUrls, asBool);
 }
@@ -77,13 +88,24 @@ std::string MapCreateOptions::toJson() const
     Json::Value v;
     TJ(clientId, asString);
     TJ(cachePath, asString);
+    TJ(localTilesetsPath, asString);
     TJ(geodataFontFallback, asString);
     TJ(searchUrlFallback, asString);
     TJ(searchSrsFallback, asString);
     TJ(customSrs1, asString);
     TJ(customSrs2, asString);
+    TJ(decodeThreads, asUInt);
+    TJ(cacheReadThreads, asUInt);
+    TJ(diskCacheMaxSizeMB, asUInt);
+    TJ(negativeCacheExpiration, asUInt);
+    TJ(textureComponents, asUInt);
+    TJ(boundTexturesMinResolution, asUInt);
+    TJE(textureCompression, TextureCompression);
     TJ(diskCache, asBool);
     TJ(hashCachePaths, asBool);
+    TJ(packedDiskCache, asBool);
+    TJ(cacheReadAhead, asBool);
+    TJ(textureMipmaps, asBool);
     TJ(searchUrlFallbackOutsideEarth, asBool);
     TJ(browserOptionsSearchUrls, asBool);
     return jsonToString(v);
@@ -108,13 +130,18 @@ void MapRuntimeOptions::applyJson(const std::string &json)
     AJ(pixelsPerInch, asDouble);
     AJ(renderTilesScale, asDouble);
     AJ(targetResourcesMemoryKB, asUInt);
+    AJ(targetGpuMemoryKB, asUInt);
+    AJ(targetRamMemoryKB, asUInt);
     AJ(maxConcurrentDownloads, asUInt);
+    AJ(maxAdaptiveConcurrentDownloads, asUInt);
     AJ(maxCacheWriteQueueLength, asUInt);
     AJ(maxResourceProcessesPerTick, asUInt);
     AJ(maxFetchRedirections, asUInt);
     AJ(maxFetchRetries, asUInt);
     AJ(fetchFirstRetryTimeOffset, asUInt);
+    AJ(cancelDownloadsAfterTicks, asUInt);
     AJ(measurementUnitsSystem, asUInt);
+    AJ(adaptiveConcurrentDownloads, asBool);
     AJ(debugVirtualSurfaces, asBool);
     AJ(debugSaveCorruptedFiles, asBool);
     AJ(debugValidateGeodataStyles, asBool);
@@ -129,13 +156,18 @@ std::string MapRuntimeOptions::toJson() const
     TJ(pixelsPerInch, asDouble);
     TJ(renderTilesScale, asDouble);
     TJ(targetResourcesMemoryKB, asUInt);
+    TJ(targetGpuMemoryKB, asUInt);
+    TJ(targetRamMemoryKB, asUInt);
     TJ(maxConcurrentDownloads, asUInt);
+    TJ(maxAdaptiveConcurrentDownloads, asUInt);
     TJ(maxCacheWriteQueueLength, asUInt);
     TJ(maxResourceProcessesPerTick, asUInt);
     TJ(maxFetchRedirections, asUInt);
     TJ(maxFetchRetries, asUInt);
     TJ(fetchFirstRetryTimeOffset, asUInt);
+    TJ(cancelDownloadsAfterTicks, asUInt);
     TJ(measurementUnitsSystem, asUInt);
+    TJ(adaptiveConcurrentDownloads, asBool);
     TJ(debugVirtualSurfaces, asBool);
     TJ(debugSaveCorruptedFiles, asBool);
     TJ(debugValidateGeodataStyles, asBool);
@@ -320,6 +352,7 @@ void FetcherOptions::applyJson(const std::string &json)
     AJ(maxTotalConnections, asUInt);
     AJ(maxCacheConections, asUInt);
     AJ(pipelining, asUInt);
+    AJ(compression, asBool);
 }
 
 std::string FetcherOptions::toJson() const
@@ -332,6 +365,7 @@ std::string FetcherOptions::toJson() const
     TJ(maxTotalConnections, asUInt);
     TJ(maxCacheConections, asUInt);
     TJ(pipelining, asUInt);
+    TJ(compression, asBool);
     return jsonToString(v);
 }
 
@@ -28,19 +28,89 @@
 #include "../include/vts-browser/mapStatistics.hpp"
 #include "../include/vts-browser/cameraStatistics.hpp"
 
+#include <algorithm>
+#include <cmath>
+
 namespace vts
 {
 
+namespace
+{
+
+const char *const ResourceTypeNames[FetchTask::ResourceTypesCount] = {
+    "undefined",
+    "mapconfig",
+    "authConfig",
+    "boundLayerConfig",
+    "freeLayerConfig",
+    "tilesetMappingConfig",
+    "boundMetaTile",
+    "metaTile",
+    "mesh",
+    "texture",
+    "navTile",
+    "search",
+    "sriIndex",
+    "geodataFeatures",
+    "geodataStylesheet",
+    "font",
+};
+
+const char *const DownloadPhaseNames[MapStatistics::DownloadPhasesCount] = {
+    "queue",
+    "nameLookup",
+    "connect",
+    "tls",
+    "firstByte",
+    "transfer",
+    "total",
+};
+
+// upper bound of the bucket, in milliseconds
+double downloadLatencyBucketLimit(uint32 bucket)
+{
+    return std::pow(2.0, bucket * 0.5);
+}
+
+void downloadLatencyJson(Json::Value &v, const uint32 *histogram)
+{
+    static const uint32 Last = MapStatistics::DownloadLatencyBuckets - 1;
+    uint64 count = 0;
+    for (uint32 i = 0; i <= Last; i++)
+        count += histogram[i];
+    if (count == 0)
+        return;
+    v["count"] = Json::UInt64(count);
+    static const std::pair<const char *, double> Percentiles[] = {
+        { "p50", 0.5 }, { "p95", 0.95 }, { "p99", 0.99 } };
+    for (const auto &p : Percentiles)
+    {
+        uint64 target = std::max<uint64>(std::ceil(count * p.second), 1);
+        uint64 sum = 0;
+        uint32 i = 0;
+        while (i < Last && (sum += histogram[i]) < target)
+            i++;
+        // the last bucket is unbounded, report its lower bound
+        v[p.first] = downloadLatencyBucketLimit(i == Last ? i - 1 : i);
+    }
+}
+
+} // namespace
+
 MapStatistics::MapStatistics() :
     resourcesCreated(0),
     resourcesDownloaded(0),
     resourcesDiskLoaded(0),
+    resourcesLocalLoaded(0),
     resourcesDecoded(0),
     resourcesUploaded(0),
     resourcesFailed(0),
+    resourcesCancelled(0),
+    resourcesRevalidated(0),
     resourcesReleased(0),
     resourcesActive(0),
     resourcesDownloading(0),
+    resourcesDownloadsLimit(0),
     resourcesPreparing(0),
     resourcesQueueCacheRead(0),
     resourcesQueueCacheWrite(0),
@@ -51,8 +121,25 @@ MapStatistics::MapStatistics() :
     resourcesQueueAtmosphere(0),
     currentGpuMemUseKB(0),
     currentRamMemUseKB(0),
+    downloadBandwidth(0),
+    diskCacheSizeKB(0),
+    diskCacheEvictions(0),
+    diskCacheHits(0),
+    diskCacheMisses(0),
+    diskCacheHitRate(0),
+    diskCacheNegativeHits(0),
+    diskCacheNegativeEntries(0),
     renderTicks(0)
-{}
+{
+    for (uint32 i = 0; i < DiskCacheReadLatencyBuckets; i++)
+        diskCacheReadLatency[i] = 0;
+    for (uint32 i = 0; i < FetchTask::ResourceTypesCount; i++)
+        downloadedBytesTransferred[i] = downloadedBytesDecoded[i] = 0;
+    for (auto &t : downloadLatency)
+        for (auto &p : t)
+            for (uint32 &b : p)
+                b = 0;
+}
 
 std::string MapStatistics::toJson() const
 {
@@ -60,12 +147,16 @@ std::string MapStatistics::toJson() const
     TJ(resourcesCreated, asUint);
     TJ(resourcesDownloaded, asUint);
     TJ(resourcesDiskLoaded, asUint);
+    TJ(resourcesLocalLoaded, asUint);
     TJ(resourcesDecoded, asUint);
     TJ(resourcesUploaded, asUint);
     TJ(resourcesFailed, asUint);
+    TJ(resourcesCancelled, asUint);
+    TJ(resourcesRevalidated, asUint);
     TJ(resourcesReleased, asUint);
     TJ(resourcesActive, asUint);
     TJ(resourcesDownloading, asUint);
+    TJ(resourcesDownloadsLimit, asUint);
     TJ(resourcesPreparing, asUint);
     TJ(resourcesQueueCacheRead, asUint);
     TJ(resourcesQueueCacheWrite, asUint);
@@ -76,6 +167,35 @@ std::string MapStatistics::toJson() const
     TJ(resourcesQueueAtmosphere, asUint);
     TJ(currentGpuMemUseKB, asUint);
     TJ(currentRamMemUseKB, asUint);
+    for (uint32 i = 0; i < FetchTask::ResourceTypesCount; i++)
+    {
+        if (downloadedBytesDecoded[i] == 0)
+            continue;
+        Json::Value &t = v["downloadedBytes"][ResourceTypeNames[i]];
+        t["transferred"] = Json::UInt64(downloadedBytesTransferred[i]);
+        t["decoded"] = Json::UInt64(downloadedBytesDecoded[i]);
+    }
+    v["downloadBandwidth"] = Json::UInt64(downloadBandwidth);
+    for (uint32 i = 0; i < FetchTask::ResourceTypesCount; i++)
+    {
+        for (uint32 j = 0; j < DownloadPhasesCount; j++)
+        {
+            Json::Value p;
+            downloadLatencyJson(p, downloadLatency[i][j]);
+            if (!p.isNull())
+                v["downloadLatency"][ResourceTypeNames[i]]
+                    [DownloadPhaseNames[j]] = p;
+        }
+    }
+    TJ(diskCacheSizeKB, asUint);
+    TJ(diskCacheEvictions, asUint);
+    TJ(diskCacheHits, asUint);
+    TJ(diskCacheMisses, asUint);
+    TJ(diskCacheHitRate, asDouble);
+    TJ(diskCacheNegativeHits, asUint);
+    TJ(diskCacheNegativeEntries, asUint);
+    for (auto it : diskCacheReadLatency)
+        v["diskCacheReadLatency"].append(it);
     TJ(renderTicks, asUint);
     return jsonToString(v);
 }
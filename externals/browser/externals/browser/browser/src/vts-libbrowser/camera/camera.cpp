@@ -148,8 +148,10 @@ bool CameraImpl::visibilityTest(TraverseNode *trav)
     {
         const MetaNode::Obb &obb = *trav->meta->obb;
         vec4 planes[6];
-        vts::frustumPlanes(viewProjCulling * obb.rotInv, planes);
-        if (!aabbTest(obb.points, planes))
+        vts::frustumPlanes(viewProjCulling * obb.rotInv(), planes);
+        const vec3 points[2] = { obb.points[0].cast<double>(),
+            obb.points[1].cast<double>() };
+        if (!aabbTest(points, planes))
             return false;
     }
     // all tests passed
@@ -199,7 +201,7 @@ double CameraImpl::coarsenessValue(TraverseNode *trav)
         && !std::isnan(meta->diskHalfAngle))
     {
         // test the value at point at the distance from the disk
-        double dist = distanceToDisk(meta->diskNormalPhys,
+        double dist = distanceToDisk(meta->diskNormalPhys.cast<double>(),
             meta->diskHeightsPhys, meta->diskHalfAngle,
             cameraPosPhys);
         double v = meta->texelSize * diskNominalDistance / dist;
@@ -364,8 +366,10 @@ void CameraImpl::renderNodeBox(TraverseNode *trav, const vec4f &color)
     };
     if (trav->meta->obb)
     {
-        task.model = trav->meta->obb->rotInv
-            * aabbMatrix(trav->meta->obb->points);
+        const MetaNode::Obb &obb = *trav->meta->obb;
+        const vec3 points[2] = { obb.points[0].cast<double>(),
+            obb.points[1].cast<double>() };
+        task.model = obb.rotInv() * aabbMatrix(points);
     }
     else
     {
@@ -59,6 +59,11 @@ public:
     vec3 convert(const vec3 &value, const std::string &from, Srs to);
     vec3 convert(const vec3 &value, Srs from, const std::string &to);
 
+    // converts all the values in place, in a single pass through proj
+    //   much faster than converting the values one by one
+    void convert(vec3 *values, uint32 count, Srs from, Srs to);
+    void convert(vec3 *values, uint32 count, const std::string &from, Srs to);
+
     vec3 geoDirect(const vec3 &position, double distance,
                               double azimuthIn, double &azimuthOut);
     vec3 geoDirect(const vec3 &position, double distance, double azimuthIn);
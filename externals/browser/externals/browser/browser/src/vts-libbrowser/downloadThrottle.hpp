@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef DOWNLOADTHROTTLE_HPP_p8w2xk4n7c
+#define DOWNLOADTHROTTLE_HPP_p8w2xk4n7c
+
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "include/vts-browser/foundation.hpp"
+
+namespace vts
+{
+
+// limits the number of concurrent downloads for each host
+// the limit is tuned from the observed latency and throughput:
+//   it grows exponentially until the first delayed reply (slow start),
+//   then additively while the replies arrive in time
+//   and shrinks multiplicatively when they are delayed
+//   (the requests are queued somewhere on the way)
+// all methods are thread safe
+class DownloadThrottle : private Immovable
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    static std::string host(const std::string &url);
+
+    // returns false if the host has reached its limit
+    //   the download is counted anyway if enforce is false
+    bool acquire(const std::string &host, uint32 initialLimit,
+        bool enforce);
+
+    // duration is measured from the acquire
+    // firstByte is the time to the first byte of the reply, 0 = unknown
+    //   it is estimated from the duration and bandwidth otherwise
+    // delayed marks replies that indicate an overloaded server
+    //   (eg. timeouts or http 503)
+    void release(const std::string &host, double firstByte,
+        double duration, uint64 bytes, bool success, bool delayed,
+        uint32 maxLimit);
+
+    // sum of the limits of the hosts with active downloads
+    uint32 limit();
+
+    // bytes per second, summed over all hosts
+    uint64 bandwidth();
+
+private:
+    struct Host
+    {
+        Clock::time_point minLatencyTime;
+        Clock::time_point lastDecrease;
+        Clock::time_point windowStart;
+        uint64 windowBytes = 0;
+        double limit = 0;
+        double minLatency = 0; // seconds, 0 = not measured yet
+        double bandwidth = 0; // bytes per second
+        uint32 inFlight = 0;
+        bool slowStart = true;
+    };
+
+    std::unordered_map<std::string, Host> hosts;
+    std::mutex mut;
+};
+
+} // namespace vts
+
+#endif
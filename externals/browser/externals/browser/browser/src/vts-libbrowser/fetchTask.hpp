@@ -27,6 +27,7 @@
 #ifndef FETCHTASK_hpp_SER68T7ZJ
 #define FETCHTASK_hpp_SER68T7ZJ
 
+#include <chrono>
 #include <memory>
 #include <string>
 
@@ -45,12 +46,30 @@ public:
     void fetchDone() override;
 
     bool performAvailTest() const;
+    void revalidate(Buffer &&content, const std::string &etag,
+        sint64 lastModified, bool availFailed);
 
     const std::string name;
     MapImpl *const map = nullptr;
     std::shared_ptr<void> availTest; // vtslibs::registry::BoundLayer::Availability
     std::weak_ptr<Resource> resource;
     uint32 redirectionsCount = 0;
+
+    // the download is counted in the throttle of this host
+    std::string throttleHost;
+    std::chrono::steady_clock::time_point queueStart;
+    std::chrono::steady_clock::time_point fetchStart;
+
+    // expired content from the disk cache
+    //   used again if the server replies 304 (not modified)
+    struct Revalidation
+    {
+        Buffer content;
+        std::string etag;
+        sint64 lastModified = -1;
+        bool availFailed = false;
+        bool active = false;
+    } revalidation;
 };
 
 } // namespace vts
@@ -26,7 +26,9 @@
 
 #include "../include/vts-browser/fetcher.hpp"
 
+#include <cmath>
 #include <fstream>
+#include <limits>
 #include <http/http.hpp>
 #include <http/resourcefetcher.hpp>
 
@@ -38,6 +40,91 @@ namespace
 
 class FetcherImpl;
 
+// http/2 stream weight of the download
+//   resources that block the traversal (configs, metatiles)
+//   are above all others, as they are small and needed first
+//   the rest follows the priority (ie. the distance from the camera):
+//   1 km -> 128, 10 km -> 96, 1000 km -> 32
+unsigned int streamWeight(const FetchTask::Query &query)
+{
+    switch (query.resourceType)
+    {
+    case FetchTask::ResourceType::Mapconfig:
+    case FetchTask::ResourceType::AuthConfig:
+    case FetchTask::ResourceType::BoundLayerConfig:
+    case FetchTask::ResourceType::FreeLayerConfig:
+    case FetchTask::ResourceType::TilesetMappingConfig:
+    case FetchTask::ResourceType::BoundMetaTile:
+    case FetchTask::ResourceType::MetaTile:
+    case FetchTask::ResourceType::GeodataStylesheet:
+        return 256;
+    default:
+        break;
+    }
+    if (!(query.priority > 0))
+        return 16; // the default weight
+    if (std::isinf(query.priority))
+        return 256;
+    double w = 32 * std::log10(query.priority) + 32;
+    return (unsigned int)std::max(1.0, std::min(w, 224.0));
+}
+
+// the received body is written directly into the buffer
+//   that is later moved into the reply
+class BufferOutput : public http::ResourceFetcher::Output
+{
+public:
+    void reserve(std::size_t size) override
+    {
+        if (size > buffer.size())
+            buffer.resize(size);
+    }
+
+    void write(const char *data, std::size_t size) override
+    {
+        if (used + size > buffer.size())
+        {
+            uint64 s = std::max<uint64>(used + size,
+                uint64(buffer.size()) * 2);
+            if (s > std::numeric_limits<uint32>::max())
+            {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Downloaded content is too large";
+            }
+            buffer.resize(s);
+        }
+        memcpy(buffer.data() + used, data, size);
+        used += size;
+    }
+
+    void transferred(std::size_t size) override
+    {
+        transferredSize = size;
+    }
+
+    void timings(const Timings &t) override
+    {
+        measured = t;
+    }
+
+    Buffer take()
+    {
+        if (used == 0)
+            buffer.free();
+        else if (used < buffer.size())
+            buffer.resize(used);
+        used = 0;
+        return std::move(buffer);
+    }
+
+    uint32 transferredSize = 0;
+    Timings measured;
+
+private:
+    Buffer buffer;
+    uint32 used = 0;
+};
+
 class Task
 {
 public:
@@ -51,6 +138,7 @@ public:
     const uint32 id;
     http::ResourceFetcher::Query query;
     std::shared_ptr<FetchTask> task;
+    std::shared_ptr<BufferOutput> output;
     bool called;
 };
 
@@ -85,6 +173,7 @@ public:
             o.maxHostConnections = options.maxHostConnections;
             o.maxTotalConections = options.maxTotalConnections;
             o.pipelining = options.pipelining;
+            o.compression = options.compression;
             htt.startClient(options.threads, &o);
         }
     }
@@ -129,9 +218,15 @@ public:
 
 Task::Task(FetcherImpl *impl, const std::shared_ptr<FetchTask> &task)
     : begin(impl->time()), impl(impl), id(impl->taskId++),
-      query(task->query.url), task(task), called(false)
+      query(task->query.url), task(task),
+      output(std::make_shared<BufferOutput>()), called(false)
 {
     query.timeout(impl->options.timeout);
+    query.weight(streamWeight(task->query));
+    query.output(output);
+    // the flag is kept alive by the task
+    query.abortFlag(std::shared_ptr<const std::atomic<bool>>(
+        task, &task->cancelled));
     for (auto it : task->query.headers)
         query.addOption(it.first, it.second);
 }
@@ -155,7 +250,20 @@ void Task::done(utility::ResourceFetcher::MultiQuery &&queries)
     assert(queries.size() == 1);
     assert(task->reply.code == 0);
     http::ResourceFetcher::Query &q = *queries.begin();
-    if (q.valid())
+    {
+        const BufferOutput::Timings &m = output->measured;
+        FetchTask::Reply::Timings &t = task->reply.timings;
+        t.nameLookup = m.nameLookup;
+        t.connect = m.connect;
+        t.tls = m.tls;
+        t.firstByte = m.firstByte;
+        t.total = m.total;
+    }
+    if (task->cancelled && !q.valid())
+    {
+        task->reply.code = FetchTask::ExtraCodes::Cancelled;
+    }
+    else if (q.valid())
     {
         const http::ResourceFetcher::Query::Body &body = q.get();
         if (body.redirect)
@@ -164,11 +272,12 @@ void Task::done(utility::ResourceFetcher::MultiQuery &&queries)
         }
         else
         {
-            task->reply.content.allocate(body.data.size());
-            memcpy(task->reply.content.data(), body.data.data(),
-                   body.data.size());
+            task->reply.content = output->take();
+            task->reply.transferredSize = output->transferredSize;
             task->reply.contentType = body.contentType;
             task->reply.expires = body.expires;
+            task->reply.etag = body.etag;
+            task->reply.lastModified = body.lastModified;
             task->reply.code = 200;
 
             // testing start
@@ -0,0 +1,593 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "../include/vts-browser/fetcher.hpp"
+
+#include <dbglog/dbglog.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <list>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace vts
+{
+
+namespace
+{
+
+// the archive consists of a file header, the records in the order
+//   in which the downloads finished, the index of the records
+//   and a footer that locates the index
+// an archive without the index (eg. after a crash)
+//   is read by scanning the records sequentially
+
+static const char Magic[] = "vtsreplay";
+static const uint32 Version = 2;
+
+struct FileHeader
+{
+    char magic[16];
+    uint32 version;
+    // maximum number of downloads in flight during the recording
+    //   0 = unknown (eg. after a crash), the replay is not limited
+    uint32 concurrency;
+};
+
+struct RecordHeader
+{
+    uint32 urlLength;
+    uint32 contentTypeLength;
+    uint32 redirectUrlLength;
+    uint32 contentSize;
+    uint32 code;
+    uint32 transferredSize;
+    uint32 resourceType;
+    uint32 etagLength;
+    sint64 expires;
+    sint64 lastModified;
+    double start; // seconds since the recording started
+    double duration; // seconds
+    double firstByte; // seconds
+};
+
+struct Footer
+{
+    uint64 indexOffset;
+    uint32 count;
+    char magic[12];
+};
+
+typedef std::chrono::steady_clock Clock;
+
+// the fetcher is not notified when a task is cancelled
+const std::chrono::milliseconds CancelCheckPeriod(50);
+
+double seconds(Clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+////////////////////////////
+// RECORDER
+////////////////////////////
+
+class RecorderImpl;
+
+// forwarded to the wrapped fetcher in place of the original task
+class RecordTask : public FetchTask
+{
+public:
+    RecordTask(RecorderImpl *recorder, const std::shared_ptr<FetchTask> &task)
+        : FetchTask(task->query), recorder(recorder), task(task),
+        start(Clock::now())
+    {
+        // the cached content that would be revalidated is not recorded
+        //   request the full content so that the archive replays
+        //   even without the disk cache
+        query.headers.erase("If-None-Match");
+        query.headers.erase("If-Modified-Since");
+    }
+
+    void fetchDone() override;
+
+    RecorderImpl *const recorder;
+    const std::shared_ptr<FetchTask> task;
+    const Clock::time_point start;
+    std::list<RecordTask*>::iterator position;
+};
+
+class RecorderImpl : public Fetcher
+{
+public:
+    RecorderImpl(const std::shared_ptr<Fetcher> &fetcher,
+        const std::string &path) : fetcher(fetcher), path(path),
+        begin(Clock::now())
+    {
+        assert(fetcher);
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LOGTHROW(err3, std::runtime_error)
+                << "Failed to open fetcher archive <" << path
+                << "> for writing";
+        }
+        FileHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, Magic, sizeof(Magic));
+        h.version = Version;
+        file.write((const char *)&h, sizeof(h));
+        LOG(info3) << "Recording downloads into <" << path << ">";
+    }
+
+    ~RecorderImpl()
+    {
+        try // destructor must not throw
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            Footer f;
+            memset(&f, 0, sizeof(f));
+            f.indexOffset = file.tellp();
+            f.count = index.size();
+            memcpy(f.magic, Magic, sizeof(Magic));
+            file.write((const char *)index.data(),
+                index.size() * sizeof(uint64));
+            file.write((const char *)&f, sizeof(f));
+            file.seekp(offsetof(FileHeader, concurrency));
+            file.write((const char *)&concurrency, sizeof(concurrency));
+            file.close();
+            LOG(info3) << "Recorded " << f.count
+                << " downloads into <" << path << ">";
+        }
+        catch (...)
+        {
+            // do nothing
+        }
+    }
+
+    void initialize() override
+    {
+        fetcher->initialize();
+    }
+
+    void finalize() override
+    {
+        fetcher->finalize();
+    }
+
+    void update() override
+    {
+        // the wrapped fetcher sees only the forwarded tasks
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            for (RecordTask *t : inFlight)
+            {
+                if (t->task->cancelled)
+                    t->cancelled = true;
+            }
+        }
+        fetcher->update();
+    }
+
+    void fetch(const std::shared_ptr<FetchTask> &task) override
+    {
+        auto t = std::make_shared<RecordTask>(this, task);
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            t->position = inFlight.insert(inFlight.end(), t.get());
+            concurrency = std::max<uint32>(concurrency, inFlight.size());
+        }
+        fetcher->fetch(t);
+    }
+
+    void record(RecordTask *t)
+    {
+        const FetchTask::Reply &r = t->reply;
+        Clock::time_point now = Clock::now();
+        RecordHeader h;
+        memset(&h, 0, sizeof(h));
+        h.urlLength = t->query.url.size();
+        h.contentTypeLength = r.contentType.size();
+        h.redirectUrlLength = r.redirectUrl.size();
+        h.contentSize = r.content.size();
+        h.code = r.code;
+        h.transferredSize = r.transferredSize;
+        h.resourceType = (uint32)t->query.resourceType;
+        h.etagLength = r.etag.size();
+        h.expires = r.expires;
+        h.lastModified = r.lastModified;
+        h.start = seconds(t->start - begin);
+        h.duration = seconds(now - t->start);
+        h.firstByte = r.timings.firstByte;
+
+        std::lock_guard<std::mutex> lock(mut);
+        inFlight.erase(t->position);
+        // cancelled downloads would not replay deterministically
+        if (r.code == FetchTask::ExtraCodes::Cancelled)
+            return;
+        index.push_back(file.tellp());
+        file.write((const char *)&h, sizeof(h));
+        file.write(t->query.url.data(), h.urlLength);
+        file.write(r.contentType.data(), h.contentTypeLength);
+        file.write(r.redirectUrl.data(), h.redirectUrlLength);
+        file.write(r.etag.data(), h.etagLength);
+        file.write(r.content.data(), h.contentSize);
+        if (!file)
+        {
+            LOG(err3) << "Failed to write into fetcher archive <"
+                << path << ">";
+        }
+    }
+
+private:
+    const std::shared_ptr<Fetcher> fetcher;
+    const std::string path;
+    const Clock::time_point begin;
+    std::ofstream file;
+    std::vector<uint64> index; // offsets of the records
+    std::list<RecordTask*> inFlight;
+    uint32 concurrency = 0;
+    std::mutex mut;
+};
+
+void RecordTask::fetchDone()
+{
+    recorder->record(this);
+    task->reply = std::move(reply);
+    task->fetchDone();
+}
+
+////////////////////////////
+// REPLAY
+////////////////////////////
+
+class ReplayImpl : public Fetcher
+{
+public:
+    ReplayImpl(const std::string &path, double timeScale)
+        : path(path), timeScale(timeScale)
+    {
+        file.open(path, std::ios::binary);
+        if (!file)
+        {
+            LOGTHROW(err3, std::runtime_error)
+                << "Failed to open fetcher archive <" << path << ">";
+        }
+        FileHeader h;
+        file.read((char *)&h, sizeof(h));
+        if (!file || memcmp(h.magic, Magic, sizeof(Magic)) != 0
+            || h.version != Version)
+        {
+            LOGTHROW(err3, std::runtime_error)
+                << "Invalid fetcher archive <" << path << ">";
+        }
+        concurrency = h.concurrency;
+        std::vector<uint64> offsets = readIndex();
+        for (uint64 o : offsets)
+        {
+            RecordHeader r;
+            std::string url;
+            if (!readRecord(o, r, url))
+                break;
+            records[url].offsets.push_back(o);
+        }
+        LOG(info3) << "Replaying " << offsets.size()
+            << " downloads of " << records.size()
+            << " urls from <" << path << ">, concurrency: "
+            << concurrency;
+    }
+
+    void initialize() override
+    {
+        if (initCount++ == 0)
+        {
+            stop = false;
+            thr = std::thread(&ReplayImpl::entry, this);
+        }
+    }
+
+    void finalize() override
+    {
+        if (--initCount == 0)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mut);
+                stop = true;
+            }
+            con.notify_all();
+            thr.join();
+        }
+    }
+
+    void update() override
+    {
+        // look for cancelled tasks now
+        {
+            std::lock_guard<std::mutex> lock(mut);
+        }
+        con.notify_all();
+    }
+
+    void fetch(const std::shared_ptr<FetchTask> &task) override
+    {
+        assert(initCount > 0);
+        assert(task->reply.code == 0);
+        Pending p;
+        p.task = task;
+        load(task, p.duration);
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            p.order = order++;
+            waiting.push_back(std::move(p));
+        }
+        con.notify_all();
+    }
+
+private:
+    struct Pending
+    {
+        std::shared_ptr<FetchTask> task;
+        Clock::time_point due;
+        double duration = 0; // seconds, as recorded
+        uint64 order = 0;
+
+        bool operator < (const Pending &other) const
+        {
+            // earliest first
+            if (due != other.due)
+                return due > other.due;
+            return order > other.order;
+        }
+    };
+
+    struct Records
+    {
+        std::vector<uint64> offsets;
+        uint32 next = 0;
+    };
+
+    std::vector<uint64> readIndex()
+    {
+        std::vector<uint64> offsets;
+        file.seekg(0, std::ios::end);
+        uint64 size = fileSize = file.tellg();
+        if (size >= sizeof(FileHeader) + sizeof(Footer))
+        {
+            Footer f;
+            file.seekg(size - sizeof(Footer));
+            file.read((char *)&f, sizeof(f));
+            if (file && memcmp(f.magic, Magic, sizeof(Magic)) == 0
+                && f.indexOffset + f.count * sizeof(uint64)
+                + sizeof(Footer) == size)
+            {
+                offsets.resize(f.count);
+                file.seekg(f.indexOffset);
+                file.read((char *)offsets.data(),
+                    f.count * sizeof(uint64));
+                if (file)
+                    return offsets;
+            }
+        }
+        LOG(warn3) << "Fetcher archive <" << path
+            << "> has no index, scanning the records";
+        file.clear();
+        offsets.clear();
+        uint64 o = sizeof(FileHeader);
+        RecordHeader r;
+        std::string url;
+        while (o < size && readRecord(o, r, url))
+        {
+            offsets.push_back(o);
+            o += sizeof(RecordHeader) + r.urlLength + r.contentTypeLength
+                + r.redirectUrlLength + r.etagLength + r.contentSize;
+        }
+        file.clear();
+        return offsets;
+    }
+
+    bool readRecord(uint64 offset, RecordHeader &r, std::string &url)
+    {
+        file.seekg(offset);
+        file.read((char *)&r, sizeof(r));
+        if (!file)
+            return false;
+        // reject damaged records
+        if (offset + sizeof(r) + r.urlLength + r.contentTypeLength
+            + r.redirectUrlLength + r.etagLength + r.contentSize > fileSize)
+            return false;
+        url.resize(r.urlLength);
+        file.read(&url[0], r.urlLength);
+        return !!file;
+    }
+
+    // the records of the same url are replayed in the recorded order
+    //   the last one is repeated
+    void load(const std::shared_ptr<FetchTask> &task, double &duration)
+    {
+        FetchTask::Reply &reply = task->reply;
+        std::lock_guard<std::mutex> lock(fileMutex);
+        auto it = records.find(task->query.url);
+        if (it == records.end())
+        {
+            LOG(warn3) << "Url <" << task->query.url
+                << "> is not in the fetcher archive";
+            reply.code = FetchTask::ExtraCodes::InternalError;
+            return;
+        }
+        Records &rs = it->second;
+        uint64 offset = rs.offsets[rs.next];
+        if (rs.next + 1 < rs.offsets.size())
+            rs.next++;
+        RecordHeader r;
+        std::string url;
+        if (!readRecord(offset, r, url))
+        {
+            file.clear();
+            LOG(err3) << "Failed to read <" << task->query.url
+                << "> from the fetcher archive";
+            reply.code = FetchTask::ExtraCodes::InternalError;
+            return;
+        }
+        reply.contentType.resize(r.contentTypeLength);
+        file.read(&reply.contentType[0], r.contentTypeLength);
+        reply.redirectUrl.resize(r.redirectUrlLength);
+        file.read(&reply.redirectUrl[0], r.redirectUrlLength);
+        reply.etag.resize(r.etagLength);
+        file.read(&reply.etag[0], r.etagLength);
+        reply.content.allocate(r.contentSize);
+        file.read(reply.content.data(), r.contentSize);
+        if (!file)
+        {
+            file.clear();
+            reply = FetchTask::Reply();
+            reply.code = FetchTask::ExtraCodes::InternalError;
+            return;
+        }
+        reply.code = r.code;
+        reply.transferredSize = r.transferredSize;
+        reply.expires = r.expires;
+        reply.lastModified = r.lastModified;
+        reply.timings.firstByte = r.firstByte;
+        reply.timings.total = r.duration;
+        duration = r.duration;
+    }
+
+    // moves cancelled tasks from the queue into done
+    template<class Queue>
+    static void takeCancelled(Queue &queue, std::vector<Pending> &done)
+    {
+        auto it = std::partition(queue.begin(), queue.end(),
+            [](const Pending &p) { return !p.task->cancelled; });
+        for (auto jt = it; jt != queue.end(); jt++)
+        {
+            jt->task->reply = FetchTask::Reply();
+            jt->task->reply.code = FetchTask::ExtraCodes::Cancelled;
+            done.push_back(std::move(*jt));
+        }
+        queue.erase(it, queue.end());
+    }
+
+    void entry()
+    {
+        std::unique_lock<std::mutex> lock(mut);
+        while (!stop)
+        {
+            std::vector<Pending> done;
+
+            // the cancellation is only signaled by the flag
+            takeCancelled(waiting, done);
+            if (!done.empty() || std::any_of(pending.begin(), pending.end(),
+                [](const Pending &p) { return !!p.task->cancelled; }))
+            {
+                takeCancelled(pending, done);
+                std::make_heap(pending.begin(), pending.end());
+            }
+
+            // start the downloads as the recorded concurrency allows
+            const Clock::time_point now = Clock::now();
+            while (!waiting.empty()
+                && (concurrency == 0 || pending.size() < concurrency))
+            {
+                Pending p = std::move(waiting.front());
+                waiting.pop_front();
+                p.due = now + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(p.duration * timeScale));
+                pending.push_back(std::move(p));
+                std::push_heap(pending.begin(), pending.end());
+            }
+
+            // finish the downloads that are due
+            while (!pending.empty() && pending.front().due <= now)
+            {
+                std::pop_heap(pending.begin(), pending.end());
+                done.push_back(std::move(pending.back()));
+                pending.pop_back();
+            }
+
+            if (!done.empty())
+            {
+                lock.unlock();
+                for (Pending &p : done)
+                    p.task->fetchDone();
+                done.clear();
+                lock.lock();
+                continue; // free slots may start waiting downloads
+            }
+
+            // check the cancellations periodically
+            Clock::time_point wake = now + CancelCheckPeriod;
+            if (!pending.empty())
+                wake = std::min(wake, pending.front().due);
+            if (pending.empty() && waiting.empty())
+                con.wait(lock);
+            else
+                con.wait_until(lock, wake);
+        }
+    }
+
+    const std::string path;
+    const double timeScale;
+    std::ifstream file;
+    uint64 fileSize = 0;
+    std::unordered_map<std::string, Records> records;
+    std::mutex fileMutex;
+    // downloads in flight, a heap ordered by their due time
+    std::vector<Pending> pending;
+    // downloads waiting for a free slot, in the order of their requests
+    std::deque<Pending> waiting;
+    uint32 concurrency = 0; // 0 = unlimited
+    std::thread thr;
+    std::mutex mut;
+    std::condition_variable con;
+    uint64 order = 0;
+    std::atomic<int> initCount {0};
+    bool stop = false;
+};
+
+} // namespace
+
+std::shared_ptr<Fetcher> Fetcher::createRecorder(
+    const std::shared_ptr<Fetcher> &fetcher, const std::string &path)
+{
+    return std::make_shared<RecorderImpl>(fetcher, path);
+}
+
+std::shared_ptr<Fetcher> Fetcher::createReplay(const std::string &path,
+    double timeScale)
+{
+    return std::make_shared<ReplayImpl>(path, timeScale);
+}
+
+} // namespace vts
@@ -46,6 +46,7 @@ public:
     GpuMesh(MapImpl *map, const std::string &name);
     GpuMesh(MapImpl *map, const std::string &name,
             const vtslibs::vts::SubMesh &m);
+    GpuMesh(MapImpl *map, const std::string &name, GpuMeshSpec &&spec);
     void decode() override;
     void upload() override;
     bool requiresUpload() override { return true; }
@@ -65,6 +66,11 @@ public:
         = GpuTextureSpec::FilterMode::Linear;
     GpuTextureSpec::WrapMode wrapMode
         = GpuTextureSpec::WrapMode::ClampToEdge;
+    // allow the decoder to reduce the resolution down to this size
+    // 0 = full resolution
+    std::atomic<uint32> downscaleLimit {0};
+    // allow block compression (see MapCreateOptions::textureCompression)
+    std::atomic<bool> compressible {false};
     uint32 width = 0, height = 0;
 };
 
@@ -27,17 +27,22 @@
 #ifndef HASHTILEID_HPP_yxf4rt7uq
 #define HASHTILEID_HPP_yxf4rt7uq
 
+#include <functional>
+
+#include <vts-libs/vts/basetypes.hpp>
+
 namespace std
 {
 
 template<>
-struct hash<vts::TileId>
+struct hash<vtslibs::vts::TileId>
 {
-    size_t operator()(const vts::TileId &x) const
+    size_t operator()(const vtslibs::vts::TileId &x) const
     {
+        using Index = vtslibs::vts::TileId::index_type;
         size_t r = std::hash<vtslibs::storage::Lod>()(x.lod) << 1;
-        r ^= std::hash<vts::TileId::index_type>()(x.x) << 1;
-        r ^= std::hash<vts::TileId::index_type>()(x.y);
+        r ^= std::hash<Index>()(x.x) << 1;
+        r ^= std::hash<Index>()(x.y);
         return r;
     }
 };
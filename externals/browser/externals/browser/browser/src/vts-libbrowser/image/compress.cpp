@@ -0,0 +1,591 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "image.hpp"
+
+#include <dbglog/dbglog.hpp>
+#include <algorithm>
+#include <cmath>
+
+namespace vts
+{
+
+namespace
+{
+
+typedef uint8 Block[16][4]; // rgba, row major
+
+void fetchBlock(const uint8 *src, uint32 width, uint32 height,
+                uint32 components, uint32 bx, uint32 by, Block &block)
+{
+    // pixels outside the image repeat the last row or column
+    for (uint32 y = 0; y < 4; y++)
+    {
+        uint32 sy = std::min(by * 4 + y, height - 1);
+        for (uint32 x = 0; x < 4; x++)
+        {
+            uint32 sx = std::min(bx * 4 + x, width - 1);
+            const uint8 *p = src + (sy * width + sx) * components;
+            uint8 *b = block[y * 4 + x];
+            b[0] = p[0];
+            b[1] = p[1];
+            b[2] = p[2];
+            b[3] = components == 4 ? p[3] : 255;
+        }
+    }
+}
+
+int clamp255(int v)
+{
+    return std::min(std::max(v, 0), 255);
+}
+
+int sqr(int v)
+{
+    return v * v;
+}
+
+void writeBigEndian(uint8 *out, uint64 v)
+{
+    for (int i = 0; i < 8; i++)
+        out[i] = (uint8)(v >> (56 - i * 8));
+}
+
+///////////////////////////////////////////////////////////////////////////
+// BC1 & BC3
+
+uint16 packRgb565(const float c[3])
+{
+    int r = clamp255((int)std::round(c[0])) * 31 / 255;
+    int g = clamp255((int)std::round(c[1])) * 63 / 255;
+    int b = clamp255((int)std::round(c[2])) * 31 / 255;
+    // rounding to nearest representable value
+    if (std::abs((r << 3 | r >> 2) - c[0])
+            > std::abs(((r + 1) << 3 | (r + 1) >> 2) - c[0]) && r < 31)
+        r++;
+    if (std::abs((g << 2 | g >> 4) - c[1])
+            > std::abs(((g + 1) << 2 | (g + 1) >> 4) - c[1]) && g < 63)
+        g++;
+    if (std::abs((b << 3 | b >> 2) - c[2])
+            > std::abs(((b + 1) << 3 | (b + 1) >> 2) - c[2]) && b < 31)
+        b++;
+    return (uint16)(r << 11 | g << 5 | b);
+}
+
+void unpackRgb565(uint16 v, int c[3])
+{
+    int r = (v >> 11) & 31;
+    int g = (v >> 5) & 63;
+    int b = v & 31;
+    c[0] = r << 3 | r >> 2;
+    c[1] = g << 2 | g >> 4;
+    c[2] = b << 3 | b >> 2;
+}
+
+// assigns the indices and returns the squared error
+uint32 bc1Indices(const Block &block, uint16 c0, uint16 c1, uint32 &indices)
+{
+    int p[4][3];
+    unpackRgb565(c0, p[0]);
+    unpackRgb565(c1, p[1]);
+    for (int k = 0; k < 3; k++)
+    {
+        p[2][k] = (2 * p[0][k] + p[1][k]) / 3;
+        p[3][k] = (p[0][k] + 2 * p[1][k]) / 3;
+    }
+    uint32 err = 0;
+    indices = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        const uint8 *px = block[i];
+        uint32 best = 0, bestErr = -1;
+        for (uint32 j = 0; j < 4; j++)
+        {
+            uint32 e = sqr(p[j][0] - px[0]) + sqr(p[j][1] - px[1])
+                    + sqr(p[j][2] - px[2]);
+            if (e < bestErr)
+            {
+                bestErr = e;
+                best = j;
+            }
+        }
+        indices |= best << (i * 2);
+        err += bestErr;
+    }
+    return err;
+}
+
+// least squares fit of the endpoints to the assigned indices
+bool bc1Refine(const Block &block, uint32 indices, float e0[3], float e1[3])
+{
+    static const float weights[4] = { 1.f, 0.f, 2.f / 3, 1.f / 3 };
+    float aa = 0, bb = 0, ab = 0;
+    float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        float a = weights[(indices >> (i * 2)) & 3];
+        float b = 1 - a;
+        aa += a * a;
+        bb += b * b;
+        ab += a * b;
+        for (int k = 0; k < 3; k++)
+        {
+            ax[k] += a * block[i][k];
+            bx[k] += b * block[i][k];
+        }
+    }
+    float det = aa * bb - ab * ab;
+    if (std::abs(det) < 1e-6f)
+        return false;
+    for (int k = 0; k < 3; k++)
+    {
+        e0[k] = (ax[k] * bb - bx[k] * ab) / det;
+        e1[k] = (bx[k] * aa - ax[k] * ab) / det;
+    }
+    return true;
+}
+
+void encodeBc1Block(const Block &block, uint8 *out)
+{
+    // principal axis of the colors
+    float mean[3] = { 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+        for (int k = 0; k < 3; k++)
+            mean[k] += block[i][k] / 16.f;
+    float cov[6] = { 0, 0, 0, 0, 0, 0 };
+    for (int i = 0; i < 16; i++)
+    {
+        float r = block[i][0] - mean[0];
+        float g = block[i][1] - mean[1];
+        float b = block[i][2] - mean[2];
+        cov[0] += r * r;
+        cov[1] += r * g;
+        cov[2] += r * b;
+        cov[3] += g * g;
+        cov[4] += g * b;
+        cov[5] += b * b;
+    }
+    float axis[3] = { 1, 1, 1 };
+    for (int it = 0; it < 4; it++)
+    {
+        float a[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2] };
+        float l = std::max(std::max(std::abs(a[0]), std::abs(a[1])),
+                           std::abs(a[2]));
+        if (l < 1e-6f)
+            break;
+        for (int k = 0; k < 3; k++)
+            axis[k] = a[k] / l;
+    }
+    float lo = 0, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        float t = (block[i][0] - mean[0]) * axis[0]
+                + (block[i][1] - mean[1]) * axis[1]
+                + (block[i][2] - mean[2]) * axis[2];
+        lo = std::min(lo, t);
+        hi = std::max(hi, t);
+    }
+    float l2 = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+    float e0[3], e1[3];
+    for (int k = 0; k < 3; k++)
+    {
+        e0[k] = mean[k] + axis[k] * hi / std::max(l2, 1e-6f);
+        e1[k] = mean[k] + axis[k] * lo / std::max(l2, 1e-6f);
+    }
+
+    uint16 c0 = packRgb565(e0);
+    uint16 c1 = packRgb565(e1);
+    uint32 indices;
+    uint32 err = bc1Indices(block, c0, c1, indices);
+    if (bc1Refine(block, indices, e0, e1))
+    {
+        uint16 d0 = packRgb565(e0);
+        uint16 d1 = packRgb565(e1);
+        uint32 ind;
+        uint32 e = bc1Indices(block, d0, d1, ind);
+        if (e < err)
+        {
+            c0 = d0;
+            c1 = d1;
+            indices = ind;
+        }
+    }
+
+    // the four color mode requires c0 > c1
+    if (c0 < c1)
+    {
+        std::swap(c0, c1);
+        indices ^= 0x55555555; // 0 <-> 1, 2 <-> 3
+    }
+    else if (c0 == c1)
+        indices = 0;
+    out[0] = (uint8)c0;
+    out[1] = (uint8)(c0 >> 8);
+    out[2] = (uint8)c1;
+    out[3] = (uint8)(c1 >> 8);
+    for (int i = 0; i < 4; i++)
+        out[4 + i] = (uint8)(indices >> (i * 8));
+}
+
+void encodeBc3AlphaBlock(const Block &block, uint8 *out)
+{
+    int a0 = 0, a1 = 255;
+    for (int i = 0; i < 16; i++)
+    {
+        a0 = std::max(a0, (int)block[i][3]);
+        a1 = std::min(a1, (int)block[i][3]);
+    }
+    // eight values mode: a0 > a1
+    int p[8] = { a0, a1 };
+    for (int j = 2; j < 8; j++)
+        p[j] = ((8 - j) * a0 + (j - 1) * a1) / 7;
+    uint64 indices = 0;
+    if (a0 > a1)
+    {
+        for (int i = 0; i < 16; i++)
+        {
+            int a = block[i][3];
+            int best = 0;
+            for (int j = 1; j < 8; j++)
+                if (std::abs(p[j] - a) < std::abs(p[best] - a))
+                    best = j;
+            indices |= (uint64)best << (i * 3);
+        }
+    }
+    out[0] = (uint8)a0;
+    out[1] = (uint8)a1;
+    for (int i = 0; i < 6; i++)
+        out[2 + i] = (uint8)(indices >> (i * 8));
+}
+
+///////////////////////////////////////////////////////////////////////////
+// ETC2
+
+const int etcModifiers[8][2] = {
+    { 2, 8 }, { 5, 17 }, { 9, 29 }, { 13, 42 },
+    { 18, 60 }, { 24, 80 }, { 33, 106 }, { 47, 183 },
+};
+
+// pixel index bits (msb, lsb) -> modifier
+//   0: +small, 1: +large, 2: -small, 3: -large
+int etcModifier(int table, int index)
+{
+    int m = etcModifiers[table][index & 1];
+    return index & 2 ? -m : m;
+}
+
+// the pixels of a half-block in the etc (column major) index order
+void etcHalfPixels(bool flip, int half, int pixels[8])
+{
+    int n = 0;
+    for (int x = 0; x < 4; x++)
+    {
+        for (int y = 0; y < 4; y++)
+        {
+            int h = flip ? y / 2 : x / 2;
+            if (h == half)
+                pixels[n++] = x * 4 + y;
+        }
+    }
+}
+
+// finds the best table and pixel indices for a half-block
+//   the indices are stored in the etc index order (x * 4 + y)
+uint32 etcFitHalf(const Block &block, const int pixels[8],
+                  const int base[3], int &table, int indices[16])
+{
+    const uint8 *px[8];
+    for (int i = 0; i < 8; i++)
+        px[i] = block[(pixels[i] % 4) * 4 + pixels[i] / 4];
+    uint32 bestErr = -1;
+    for (int t = 0; t < 8; t++)
+    {
+        int colors[4][3];
+        for (int j = 0; j < 4; j++)
+            for (int k = 0; k < 3; k++)
+                colors[j][k] = clamp255(base[k] + etcModifier(t, j));
+        uint32 err = 0;
+        int ind[8];
+        for (int i = 0; i < 8 && err < bestErr; i++)
+        {
+            uint32 be = -1;
+            for (int j = 0; j < 4; j++)
+            {
+                uint32 e = sqr(colors[j][0] - px[i][0])
+                        + sqr(colors[j][1] - px[i][1])
+                        + sqr(colors[j][2] - px[i][2]);
+                if (e < be)
+                {
+                    be = e;
+                    ind[i] = j;
+                }
+            }
+            err += be;
+        }
+        if (err < bestErr)
+        {
+            bestErr = err;
+            table = t;
+            for (int i = 0; i < 8; i++)
+                indices[pixels[i]] = ind[i];
+        }
+    }
+    return bestErr;
+}
+
+void encodeEtc2RgbBlock(const Block &block, uint8 *out)
+{
+    uint32 bestErr = -1;
+    uint64 best = 0;
+    for (int flip = 0; flip < 2; flip++)
+    {
+        int pixels[2][8];
+        float avg[2][3];
+        for (int h = 0; h < 2; h++)
+        {
+            etcHalfPixels(flip, h, pixels[h]);
+            for (int k = 0; k < 3; k++)
+            {
+                int sum = 0;
+                for (int i = 0; i < 8; i++)
+                    sum += block[(pixels[h][i] % 4) * 4
+                            + pixels[h][i] / 4][k];
+                avg[h][k] = sum / 8.f;
+            }
+        }
+
+        for (int diff = 0; diff < 2; diff++)
+        {
+            int q[2][3], base[2][3];
+            bool valid = true;
+            for (int k = 0; k < 3; k++)
+            {
+                for (int h = 0; h < 2; h++)
+                {
+                    if (diff)
+                    {
+                        q[h][k] = (int)std::round(avg[h][k] * 31 / 255);
+                        base[h][k] = q[h][k] << 3 | q[h][k] >> 2;
+                    }
+                    else
+                    {
+                        q[h][k] = (int)std::round(avg[h][k] * 15 / 255);
+                        base[h][k] = q[h][k] << 4 | q[h][k];
+                    }
+                }
+                // the difference must fit into three bits,
+                //   otherwise the block would decode in another etc2 mode
+                if (diff && (q[1][k] - q[0][k] < -4 || q[1][k] - q[0][k] > 3))
+                    valid = false;
+            }
+            if (!valid)
+                continue;
+
+            int tables[2];
+            int indices[16];
+            uint32 err = etcFitHalf(block, pixels[0], base[0],
+                                    tables[0], indices)
+                    + etcFitHalf(block, pixels[1], base[1],
+                                 tables[1], indices);
+            if (err >= bestErr)
+                continue;
+            bestErr = err;
+
+            uint64 v = 0;
+            for (int k = 0; k < 3; k++)
+            {
+                uint64 c;
+                if (diff)
+                    c = (uint64)q[0][k] << 3 | ((q[1][k] - q[0][k]) & 7);
+                else
+                    c = (uint64)q[0][k] << 4 | q[1][k];
+                v |= c << (56 - k * 8);
+            }
+            v |= (uint64)tables[0] << 37;
+            v |= (uint64)tables[1] << 34;
+            v |= (uint64)diff << 33;
+            v |= (uint64)flip << 32;
+            for (int i = 0; i < 16; i++)
+            {
+                v |= (uint64)(indices[i] >> 1) << (16 + i);
+                v |= (uint64)(indices[i] & 1) << i;
+            }
+            best = v;
+        }
+    }
+    writeBigEndian(out, best);
+}
+
+const int eacModifiers[16][8] = {
+    { -3, -6, -9, -15, 2, 5, 8, 14 },
+    { -3, -7, -10, -13, 2, 6, 9, 12 },
+    { -2, -5, -8, -13, 1, 4, 7, 12 },
+    { -2, -4, -6, -13, 1, 3, 5, 12 },
+    { -3, -6, -8, -12, 2, 5, 7, 11 },
+    { -3, -7, -9, -11, 2, 6, 8, 10 },
+    { -4, -7, -8, -11, 3, 6, 7, 10 },
+    { -3, -5, -8, -11, 2, 4, 7, 10 },
+    { -2, -6, -8, -10, 1, 5, 7, 9 },
+    { -2, -5, -8, -10, 1, 4, 7, 9 },
+    { -2, -4, -8, -10, 1, 3, 7, 9 },
+    { -2, -5, -7, -10, 1, 4, 6, 9 },
+    { -3, -4, -7, -10, 2, 3, 6, 9 },
+    { -1, -2, -3, -10, 0, 1, 2, 9 },
+    { -4, -6, -8, -9, 3, 5, 7, 8 },
+    { -3, -5, -7, -9, 2, 4, 6, 8 },
+};
+
+void encodeEacAlphaBlock(const Block &block, uint8 *out)
+{
+    int lo = 255, hi = 0;
+    for (int i = 0; i < 16; i++)
+    {
+        lo = std::min(lo, (int)block[i][3]);
+        hi = std::max(hi, (int)block[i][3]);
+    }
+    if (lo == hi)
+    {
+        // table 13 has zero modifier at index 4
+        uint64 indices = 0;
+        for (int i = 0; i < 16; i++)
+            indices |= (uint64)4 << (i * 3);
+        writeBigEndian(out, (uint64)lo << 56 | (uint64)1 << 52
+                            | (uint64)13 << 48 | indices);
+        return;
+    }
+    uint32 bestErr = -1;
+    uint64 best = 0;
+    for (int t = 0; t < 16; t++)
+    {
+        const int *mods = eacModifiers[t];
+        int range = mods[7] - mods[3];
+        int m0 = std::max((hi - lo + range / 2) / range, 1);
+        for (int m = std::max(m0 - 1, 1); m <= std::min(m0 + 1, 15); m++)
+        {
+            int base = clamp255((lo - mods[3] * m + hi - mods[7] * m + 1)
+                                / 2);
+            uint32 err = 0;
+            uint64 indices = 0;
+            for (int i = 0; i < 16 && err < bestErr; i++)
+            {
+                // etc index order is column major
+                int a = block[(i % 4) * 4 + i / 4][3];
+                int bi = 0;
+                uint32 be = -1;
+                for (int j = 0; j < 8; j++)
+                {
+                    uint32 e = sqr(clamp255(base + mods[j] * m) - a);
+                    if (e < be)
+                    {
+                        be = e;
+                        bi = j;
+                    }
+                }
+                err += be;
+                indices |= (uint64)bi << (45 - i * 3);
+            }
+            if (err < bestErr)
+            {
+                bestErr = err;
+                best = (uint64)base << 56 | (uint64)m << 52
+                        | (uint64)t << 48 | indices;
+            }
+        }
+        if (bestErr == 0)
+            break;
+    }
+    writeBigEndian(out, best);
+}
+
+void checkInput(const Buffer &in, uint32 width, uint32 height,
+                uint32 components)
+{
+    if (components != 3 && components != 4)
+        LOGTHROW(err2, std::runtime_error)
+                << "Block compression requires rgb or rgba image";
+    if (in.size() != width * height * components)
+        LOGTHROW(err2, std::runtime_error)
+                << "Buffer with image for block compression has invalid size";
+}
+
+} // namespace
+
+void encodeBc(const Buffer &in, Buffer &out,
+              uint32 width, uint32 height, uint32 components)
+{
+    checkInput(in, width, height, components);
+    uint32 bw = (width + 3) / 4, bh = (height + 3) / 4;
+    uint32 bs = components == 4 ? 16 : 8;
+    out.allocate(bw * bh * bs);
+    uint8 *o = (uint8*)out.data();
+    Block block;
+    for (uint32 by = 0; by < bh; by++)
+    {
+        for (uint32 bx = 0; bx < bw; bx++)
+        {
+            fetchBlock((const uint8*)in.data(), width, height, components,
+                       bx, by, block);
+            if (components == 4)
+            {
+                encodeBc3AlphaBlock(block, o);
+                o += 8;
+            }
+            encodeBc1Block(block, o);
+            o += 8;
+        }
+    }
+}
+
+void encodeEtc2(const Buffer &in, Buffer &out,
+                uint32 width, uint32 height, uint32 components)
+{
+    checkInput(in, width, height, components);
+    uint32 bw = (width + 3) / 4, bh = (height + 3) / 4;
+    uint32 bs = components == 4 ? 16 : 8;
+    out.allocate(bw * bh * bs);
+    uint8 *o = (uint8*)out.data();
+    Block block;
+    for (uint32 by = 0; by < bh; by++)
+    {
+        for (uint32 bx = 0; bx < bw; bx++)
+        {
+            fetchBlock((const uint8*)in.data(), width, height, components,
+                       bx, by, block);
+            if (components == 4)
+            {
+                encodeEacAlphaBlock(block, o);
+                o += 8;
+            }
+            encodeEtc2RgbBlock(block, o);
+            o += 8;
+        }
+    }
+}
+
+} // namespace vts
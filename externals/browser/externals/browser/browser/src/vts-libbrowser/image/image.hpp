@@ -32,18 +32,54 @@
 namespace vts
 {
 
+// transformations applied while the image is being decoded
+//   so that the output buffer is in its final form
+struct ImageDecodeOptions
+{
+    // number of channels of the output
+    //   gray is replicated into rgb and missing alpha is opaque
+    //   images with more channels are left as is
+    // 0 = keep the channels of the image, 3 or 4 = expand
+    uint32 components = 0;
+
+    // jpeg images are downscaled by 1/2, 1/4 or 1/8 in the dct domain
+    //   as long as both dimensions stay at least this large
+    // 0 = decode at full resolution
+    uint32 minResolution = 0;
+
+    // store the rows bottom-up (as expected by opengl)
+    bool bottomUp = false;
+};
+
 void decodePng(const Buffer &in, Buffer &out,
-               uint32 &width, uint32 &height, uint32 &components);
+               uint32 &width, uint32 &height, uint32 &components,
+               const ImageDecodeOptions &options = ImageDecodeOptions());
 
 void decodeJpeg(const Buffer &in, Buffer &out,
-                uint32 &width, uint32 &height, uint32 &components);
+                uint32 &width, uint32 &height, uint32 &components,
+                const ImageDecodeOptions &options = ImageDecodeOptions());
 
 void decodeImage(const Buffer &in, Buffer &out,
-                 uint32 &width, uint32 &height, uint32 &components);
+                 uint32 &width, uint32 &height, uint32 &components,
+                 const ImageDecodeOptions &options = ImageDecodeOptions());
 
 void encodePng(const Buffer &in, Buffer &out,
                uint32 width, uint32 height, uint32 components);
 
+// halve the resolution of an 8-bit image with a box filter
+//   the output has max(width / 2, 1) x max(height / 2, 1) pixels
+void downsampleImage(const Buffer &in, Buffer &out,
+                     uint32 width, uint32 height, uint32 components);
+
+// encode an 8-bit rgb or rgba image into blocks of 4x4 pixels
+//   bc1 for rgb and bc3 for rgba
+void encodeBc(const Buffer &in, Buffer &out,
+              uint32 width, uint32 height, uint32 components);
+
+// etc2 rgb8 for rgb and etc2 rgba8 eac for rgba
+void encodeEtc2(const Buffer &in, Buffer &out,
+                uint32 width, uint32 height, uint32 components);
+
 } // namespace vts
 
 #endif
@@ -24,7 +24,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "../include/vts-browser/buffer.hpp"
+#include "image.hpp"
 
 #include <stdio.h> // needed for jpeglib
 #include <jpeglib.h>
@@ -48,7 +48,8 @@ void jpegErrFunc(j_common_ptr cinfo)
 } // namespace
 
 void decodeJpeg(const Buffer &in, Buffer &out,
-                uint32 &width, uint32 &height, uint32 &components)
+                uint32 &width, uint32 &height, uint32 &components,
+                const ImageDecodeOptions &options)
 {
     jpeg_decompress_struct info;
     jpeg_error_mgr errmgr;
@@ -59,17 +60,36 @@ void decodeJpeg(const Buffer &in, Buffer &out,
         jpeg_create_decompress(&info);
         jpeg_mem_src(&info, (unsigned char*)in.data(), in.size());
         jpeg_read_header(&info, TRUE);
+        if (options.components >= 3
+            && info.out_color_space != JCS_CMYK)
+        {
+            // the color conversion writes the expanded pixels directly
+            info.out_color_space
+                = options.components == 4 ? JCS_EXT_RGBA : JCS_RGB;
+        }
+        if (options.minResolution > 0)
+        {
+            uint32 denom = 1;
+            while (denom < 8
+                && info.image_width / (denom * 2) >= options.minResolution
+                && info.image_height / (denom * 2) >= options.minResolution)
+                denom *= 2;
+            info.scale_num = 1;
+            info.scale_denom = denom;
+        }
         jpeg_start_decompress(&info);
         width = info.output_width;
         height = info.output_height;
-        components = info.num_components;
+        components = info.output_components;
         uint32 lineSize = components * width;
         out = Buffer(lineSize * height);
         while (info.output_scanline < info.output_height)
         {
+            uint32 y = info.output_scanline;
+            if (options.bottomUp)
+                y = height - 1 - y;
             unsigned char *ptr[1];
-            ptr[0] = (unsigned char*)out.data()
-                    + lineSize * info.output_scanline;
+            ptr[0] = (unsigned char*)out.data() + lineSize * y;
             jpeg_read_scanlines(&info, ptr, 1);
         }
         jpeg_finish_decompress(&info);
@@ -0,0 +1,60 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "image.hpp"
+
+#include <dbglog/dbglog.hpp>
+
+namespace vts
+{
+
+void downsampleImage(const Buffer &in, Buffer &out,
+                     uint32 width, uint32 height, uint32 components)
+{
+    if (in.size() != width * height * components)
+        LOGTHROW(err2, std::runtime_error)
+                << "Buffer with image for downsampling has invalid size";
+    uint32 ow = std::max(width / 2, 1u);
+    uint32 oh = std::max(height / 2, 1u);
+    // the source column and row offsets of the second sample
+    uint32 sx = width > 1 ? components : 0;
+    uint32 sy = height > 1 ? width * components : 0;
+    out.allocate(ow * oh * components);
+    uint8 *o = (uint8*)out.data();
+    for (uint32 y = 0; y < oh; y++)
+    {
+        const uint8 *r = (const uint8*)in.data() + y * 2 * width * components;
+        for (uint32 x = 0; x < ow; x++)
+        {
+            const uint8 *p = r + x * (width > 1 ? 2 : 1) * components;
+            for (uint32 c = 0; c < components; c++)
+                *o++ = (p[c] + p[c + sx] + p[c + sy] + p[c + sx + sy] + 2)
+                        / 4;
+        }
+    }
+}
+
+} // namespace vts
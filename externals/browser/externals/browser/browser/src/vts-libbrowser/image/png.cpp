@@ -24,7 +24,7 @@
  * POSSIBILITY OF SUCH DAMAGE.
  */
 
-#include "../include/vts-browser/buffer.hpp"
+#include "image.hpp"
 
 #include <png.h>
 #include <dbglog/dbglog.hpp>
@@ -94,7 +94,8 @@ void pngFlushFunc(png_structp)
 } // namespace
 
 void decodePng(const Buffer &in, Buffer &out,
-               uint32 &width, uint32 &height, uint32 &components)
+               uint32 &width, uint32 &height, uint32 &components,
+               const ImageDecodeOptions &options)
 {
     pngInfoCtx ctx;
     png_structp &png = ctx.png;
@@ -119,6 +120,10 @@ void decodePng(const Buffer &in, Buffer &out,
     png_set_palette_to_rgb(png);
     png_set_expand_gray_1_2_4_to_8(png);
     png_set_tRNS_to_alpha(png);
+    if (options.components >= 3)
+        png_set_gray_to_rgb(png);
+    if (options.components == 4)
+        png_set_add_alpha(png, 0xff, PNG_FILLER_AFTER); // if missing
 
     png_read_update_info(png, info);
     png_byte colorType = png_get_color_type(png, info);
@@ -148,7 +153,10 @@ void decodePng(const Buffer &in, Buffer &out,
     assert(cols == png_get_rowbytes(png,info));
     out.allocate(height * cols);
     for (uint32 y = 0; y < height; y++)
-        rows[y] = (png_bytep)out.data() + y * cols;
+    {
+        rows[options.bottomUp ? height - 1 - y : y]
+            = (png_bytep)out.data() + y * cols;
+    }
     png_read_image(png, rows.data());
 }
 
@@ -29,6 +29,8 @@
 
 #include <iostream>
 #include <string>
+#include <memory>
+#include <vector>
 
 #include "foundation.hpp"
 
@@ -54,6 +56,17 @@ public:
     // explicitly create a copy
     Buffer copy() const;
 
+    // create buffer that refers to memory owned by another object
+    //   no data are copied, the owner is kept alive by the buffer
+    //   the memory must not be modified through the buffer
+    static Buffer wrap(const char *data, uint32 size,
+        const std::shared_ptr<const void> &owner);
+
+    // create another buffer that refers to the same memory
+    //   this buffer is converted to shared ownership first, if needed
+    //   the memory must not be modified through either buffer afterwards
+    Buffer share();
+
     // explicitly create string out of the buffer
     std::string str() const;
 
@@ -80,6 +93,7 @@ public:
 private:
     char *data_;
     uint32 size_;
+    std::shared_ptr<const void> owner_; // set for wrapped memory only
 };
 
 VTS_API void writeLocalFileBuffer(const std::string &path,
@@ -93,6 +107,10 @@ VTS_API Buffer readInternalMemoryBuffer(const std::string &path);
 namespace detail
 {
 
+// writes concatenation of the parts into the file
+VTS_API void writeLocalFileParts(const std::string &path,
+    const std::vector<std::pair<const void *, uint32>> &parts);
+
 // a convenient buffer wrapper that allows to treat the buffer as a stream
 // the buffer must outlive the wrapper and may not be modified
 class VTS_API BufferStream : protected std::streambuf, public std::istream
@@ -30,6 +30,7 @@
 #include <string>
 #include <memory>
 #include <map>
+#include <atomic>
 
 #include "foundation.hpp"
 #include "buffer.hpp"
@@ -59,6 +60,7 @@ public:
         GeodataStylesheet,
         Font,
     };
+    static const uint32 ResourceTypesCount = (uint32)ResourceType::Font + 1;
 
     struct VTS_API ExtraCodes
     {
@@ -72,6 +74,8 @@ public:
             ProhibitedContent = 10403,
             // Content is rejected to simulate errors for testing purposes.
             SimulatedError = 10000,
+            // The download was cancelled because it is no longer needed.
+            Cancelled = 10499,
         };
     };
 
@@ -81,6 +85,13 @@ public:
         std::map<std::string, std::string> headers;
         ResourceType resourceType;
 
+        // importance of the resource at the time the download starts
+        //   higher is more important, infinity for essential resources
+        //   it is inversely proportional to the distance from the camera
+        // fetchers may use it to share the bandwidth among concurrent
+        //   downloads (eg. http/2 stream weights)
+        float priority = 0;
+
         explicit Query(const std::string &url, ResourceType resourceType);
     };
 
@@ -95,13 +106,42 @@ public:
         //   -2 = always revalidate
         sint64 expires = -1;
 
+        // validators used to revalidate the content once it expires
+        //   empty etag or lastModified -1 = not provided
+        std::string etag;
+        sint64 lastModified = -1;
+
         // http status code, or one of the ExtraCodes
         uint32 code = 0;
+
+        // size of the content as received over the network
+        //   it is smaller than the content if it was compressed
+        //   0 = unknown
+        uint32 transferredSize = 0;
+
+        // durations of the download, in seconds since its start
+        //   0 = unknown or the phase did not happen
+        //   (eg. the connection was reused)
+        struct Timings
+        {
+            double nameLookup = 0;
+            double connect = 0;
+            double tls = 0; // handshake completed
+            double firstByte = 0; // until the response started arriving
+            double total = 0;
+        };
+        Timings timings;
     };
 
     Query query;
     Reply reply;
 
+    // set when the resource is no longer needed
+    //   the fetcher should abort the download, if possible,
+    //   and finish the task with ExtraCodes::Cancelled
+    // the fetcher may still finish the task normally
+    std::atomic<bool> cancelled {false};
+
     explicit FetchTask(const Query &query);
     explicit FetchTask(const std::string &url, ResourceType resourceType);
     virtual ~FetchTask();
@@ -136,6 +176,10 @@ public:
     // 2 = use http/2, fallback http/1
     // 3 = use http/2, fallback http/1.1
     sint32 pipelining = 2;
+
+    // request compressed transfers (gzip, deflate, ...)
+    //   the content is decompressed in the fetcher threads
+    bool compression = true;
 };
 
 class VTS_API Fetcher : private Immovable
@@ -143,6 +187,19 @@ class VTS_API Fetcher : private Immovable
 public:
     static std::shared_ptr<Fetcher> create(const FetcherOptions &options);
 
+    // wraps the fetcher and writes all requests and replies,
+    //   including timings, into a single archive file
+    static std::shared_ptr<Fetcher> createRecorder(
+        const std::shared_ptr<Fetcher> &fetcher, const std::string &path);
+
+    // serves the replies from an archive made by the recorder
+    //   no network is used
+    // timeScale multiplies the recorded durations of the downloads
+    //   0 = reply immediately, 1 = simulate the recorded latency
+    //   and bandwidth
+    static std::shared_ptr<Fetcher> createReplay(const std::string &path,
+        double timeScale = 0);
+
     virtual ~Fetcher();
     virtual void initialize();
     virtual void finalize();
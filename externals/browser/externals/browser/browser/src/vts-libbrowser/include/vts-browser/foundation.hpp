@@ -118,6 +118,19 @@ enum class TraverseMode
     Fixed,
 };
 
+enum class TextureCompression
+{
+    None,
+
+    // BC1 for rgb and BC3 for rgba textures (also known as S3TC DXT1/DXT5)
+    //   widely supported by desktop gpus
+    Bc,
+
+    // ETC2 RGB8 and ETC2 RGBA8 EAC
+    //   core in OpenGL ES 3.0 and OpenGL 4.3
+    Etc2,
+};
+
 enum class FreeLayerType
 {
     Unknown,
@@ -159,6 +172,12 @@ UTILITY_GENERATE_ENUM_IO(TraverseMode,
     ((Fixed)("fixed"))
 )
 
+UTILITY_GENERATE_ENUM_IO(TextureCompression,
+    ((None)("none"))
+    ((Bc)("bc"))
+    ((Etc2)("etc2"))
+)
+
 #endif // UTILITY_GENERATE_ENUM_IO
 
 struct Immovable
@@ -52,6 +52,13 @@ public:
     // leave it empty to use default ($HOME/.cache/vts-browser)
     std::string cachePath;
 
+    // path to a directory with tilesets stored on the local disk
+    //   one subdirectory per tileset, named by the tileset id
+    // meshes, metatiles and atlases of surfaces found there
+    //   are read directly from their tilar archives instead of downloading
+    // leave it empty to download everything
+    std::string localTilesetsPath;
+
     // url to font to be used when stylesheet does not define default font
     std::string geodataFontFallback;
 
@@ -65,6 +72,45 @@ public:
     std::string customSrs1;
     std::string customSrs2;
 
+    // number of threads used for decoding resources
+    // 0 = determine automatically from the hardware concurrency
+    uint32 decodeThreads = 0;
+
+    // number of threads reading from the disk cache concurrently
+    // 0 = read in the cache reader thread only
+    uint32 cacheReadThreads = 4;
+
+    // maximum size of the disk cache
+    //   expired and least recently used entries are evicted
+    // 0 = unlimited
+    uint32 diskCacheMaxSizeMB = 0;
+
+    // how long are resources missing on the server (eg. http 404)
+    //   remembered in the disk cache, unless the server specifies otherwise
+    //   known missing resources are not requested again
+    // 0 = do not remember missing resources
+    uint32 negativeCacheExpiration = 24 * 3600;
+
+    // number of channels of the textures passed to loadTexture callback
+    //   gray is expanded to rgb and missing alpha is filled as opaque
+    //   during decoding, eg. use 4 for an engine that accepts rgba only
+    // 0 = keep the channels of the image files
+    uint32 textureComponents = 0;
+
+    // bound layer textures in jpeg are decoded at reduced resolution
+    //   (1/2, 1/4 or 1/8) while both dimensions stay at least this large
+    //   eg. 256 matches the texel density assumed by the traversal
+    //   and saves memory with high resolution bound layer tiles
+    // textures of the finest lod of the bound layer are always full
+    // 0 = full resolution
+    uint32 boundTexturesMinResolution = 0;
+
+    // block compression of the surface and bound layer textures
+    //   done on the decode threads, the mipmaps are generated too
+    //   and the textures switch to trilinear filtering
+    // make sure that the gpu supports the chosen format
+    TextureCompression textureCompression = TextureCompression::None;
+
     // use hard drive cache for downloads
     bool diskCache;
 
@@ -74,6 +120,21 @@ public:
     //          is clearly reflected in the cached file name
     bool hashCachePaths = true;
 
+    // true -> store the disk cache in few large memory mapped files
+    //         entries from individual files are moved in when accessed
+    //         the cache directory cannot be shared by multiple maps
+    // false -> store each resource in individual file
+    bool packedDiskCache = false;
+
+    // read ahead child metatiles and sibling textures from the disk cache
+    bool cacheReadAhead = false;
+
+    // generate the mipmaps of textures on the decode threads
+    //   instead of leaving it to the renderer
+    // the surface and bound layer textures, which are otherwise
+    //   sampled without mipmaps, switch to trilinear filtering
+    bool textureMipmaps = false;
+
     // use search url/srs fallbacks on any body (not just Earth)
     bool searchUrlFallbackOutsideEarth = false;
 
@@ -107,9 +168,19 @@ public:
     // memory threshold at which resources start to be released
     uint32 targetResourcesMemoryKB = 0;
 
+    // additional thresholds for gpu and ram memory separately
+    // resources are released only if they use the exceeded kind of memory
+    // 0 = no separate threshold
+    uint32 targetGpuMemoryKB = 0;
+    uint32 targetRamMemoryKB = 0;
+
     // maximum size of the queue for the resources to be downloaded
+    // with adaptive downloads, this is the initial limit for each host
     uint32 maxConcurrentDownloads = 25;
 
+    // upper bound for the adaptive limit of each host
+    uint32 maxAdaptiveConcurrentDownloads = 200;
+
     // maximum number of items waiting in queue to be written to disk cache
     // new resources will be skipped when the queue is full
     uint32 maxCacheWriteQueueLength = 500;
@@ -128,6 +199,11 @@ public:
     // each subsequent retry is delayed twice as long as before
     uint32 fetchFirstRetryTimeOffset = 1;
 
+    // downloads of resources that were not accessed
+    //   for this many render ticks are cancelled
+    // 0 = never cancel downloads
+    uint32 cancelDownloadsAfterTicks = 10;
+
     // 0 = US customary units
     // 1 = metric
     // when new instance of this structure is created,
@@ -135,6 +211,10 @@ public:
     //   from the environment locale settings
     uint32 measurementUnitsSystem;
 
+    // tune the number of concurrent downloads for each host
+    //   from the observed latency and throughput
+    bool adaptiveConcurrentDownloads = false;
+
     bool debugVirtualSurfaces = true;
     bool debugSaveCorruptedFiles = false;
     bool debugValidateGeodataStyles = false;
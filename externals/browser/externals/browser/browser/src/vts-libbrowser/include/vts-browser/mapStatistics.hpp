@@ -30,6 +30,7 @@
 #include <string>
 
 #include "foundation.hpp"
+#include "fetcher.hpp"
 
 namespace vts
 {
@@ -43,13 +44,17 @@ public:
     uint32 resourcesCreated;
     uint32 resourcesDownloaded;
     uint32 resourcesDiskLoaded;
+    uint32 resourcesLocalLoaded; // read from local tilesets
     uint32 resourcesDecoded;
     uint32 resourcesUploaded;
     uint32 resourcesFailed;
+    uint32 resourcesCancelled;
+    uint32 resourcesRevalidated; // expired, but not modified on the server
     uint32 resourcesReleased;
 
     uint32 resourcesActive;
     uint32 resourcesDownloading;
+    uint32 resourcesDownloadsLimit; // current limit of concurrent downloads
     uint32 resourcesPreparing;
     uint32 resourcesQueueCacheRead;
     uint32 resourcesQueueCacheWrite;
@@ -62,6 +67,55 @@ public:
     uint32 currentGpuMemUseKB;
     uint32 currentRamMemUseKB;
 
+    // total bytes of successfully downloaded content
+    //   indexed by FetchTask::ResourceType
+    //   transferred = received over the network (possibly compressed)
+    //   decoded = after decompression
+    uint64 downloadedBytesTransferred[FetchTask::ResourceTypesCount];
+    uint64 downloadedBytesDecoded[FetchTask::ResourceTypesCount];
+    uint64 downloadBandwidth; // bytes per second, measured
+
+    enum class DownloadPhase
+    {
+        Queue, // waiting in the browser for a free download slot
+        NameLookup,
+        Connect,
+        Tls,
+        FirstByte, // since the start of the request
+        Transfer, // after the first byte
+        Total,
+    };
+    static const uint32 DownloadPhasesCount
+        = (uint32)DownloadPhase::Total + 1;
+
+    // histograms of durations of the download phases
+    //   indexed by FetchTask::ResourceType, DownloadPhase and bucket
+    //   bucket i counts durations shorter than 2^(i/2) milliseconds
+    //   (that are not counted in any previous bucket)
+    //   the last bucket counts all longer durations
+    // phases that did not happen (eg. on reused connections) are not counted
+    // the json contains the count and percentiles p50, p95 and p99
+    static const uint32 DownloadLatencyBuckets = 36;
+    uint32 downloadLatency[FetchTask::ResourceTypesCount]
+        [DownloadPhasesCount][DownloadLatencyBuckets];
+
+    // size is known only when the cache is packed or limited
+    uint32 diskCacheSizeKB;
+    uint32 diskCacheEvictions;
+    uint32 diskCacheHits;
+    uint32 diskCacheMisses;
+    double diskCacheHitRate;
+    // resources known to be missing on the server
+    uint32 diskCacheNegativeHits; // requests avoided
+    uint32 diskCacheNegativeEntries;
+
+    // histogram of disk cache read latencies
+    //   bucket i counts reads faster than 64 * 2^i microseconds
+    //   (that are not counted in any previous bucket)
+    //   the last bucket counts all slower reads
+    static const uint32 DiskCacheReadLatencyBuckets = 12;
+    uint32 diskCacheReadLatency[DiskCacheReadLatencyBuckets];
+
     uint32 renderTicks;
 };
 
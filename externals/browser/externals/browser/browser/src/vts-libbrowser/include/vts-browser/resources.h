@@ -56,6 +56,9 @@ VTS_API uint32 vtsTextureGetFilterMode(vtsHResource resource);
 VTS_API uint32 vtsTextureGetWrapMode(vtsHResource resource);
 VTS_API void vtsTextureGetBuffer(vtsHResource resource,
                 void **data, uint32 *size);
+VTS_API uint32 vtsTextureGetMipmapsCount(vtsHResource resource);
+VTS_API void vtsTextureGetMipmapBuffer(vtsHResource resource, uint32 index,
+                void **data, uint32 *size); // index 0 is the level 1
 
 // mesh
 VTS_API uint32 vtsMeshGetFaceMode(vtsHResource resource);
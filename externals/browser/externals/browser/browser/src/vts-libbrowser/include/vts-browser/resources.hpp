@@ -29,6 +29,7 @@
 
 #include <array>
 #include <memory>
+#include <vector>
 
 #include "buffer.hpp"
 
@@ -85,6 +86,8 @@ public:
     // enforce texture internal format
     //   leave zero to deduce the format from type and components
     // the type must still be set appropriately since it defines buffer size
+    // block compressed formats (see MapCreateOptions::textureCompression)
+    //   have the buffers filled with the compressed blocks instead
     uint32 internalFormat = 0;
 
     // raw texture data
@@ -93,8 +96,19 @@ public:
     //   (GL_UNPACK_ALIGNMENT = 1)
     Buffer buffer;
 
-    // expected size based on width * height * components * gpuTypeSize(type)
-    uint32 expectedSize() const;
+    // additional mipmap levels 1, 2, ... in the same format as the buffer
+    //   each level has half the resolution of the previous one
+    //   (rounded down, at least 1), the last level is 1x1
+    // empty = the application generates the mipmaps, if needed
+    std::vector<Buffer> mipmaps;
+
+    // expected size of the buffer of the specified mipmap level
+    //   based on width * height * components * gpuTypeSize(type)
+    //   or the number of blocks for compressed formats
+    uint32 expectedSize(uint32 level = 0) const;
+
+    // true if the internalFormat is one of the supported block compressions
+    bool compressed() const;
 
     // encode the image into png format
     Buffer encodePng() const;
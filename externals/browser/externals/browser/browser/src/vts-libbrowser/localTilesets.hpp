@@ -0,0 +1,91 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef LOCALTILESETS_HPP_m3q8vz5rkd
+#define LOCALTILESETS_HPP_m3q8vz5rkd
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <vts-libs/vts/urltemplate.hpp>
+
+#include "include/vts-browser/buffer.hpp"
+
+namespace vts
+{
+
+using vtslibs::vts::UrlTemplate;
+
+// tilesets stored on a local disk (as written by the vts-libs plain driver)
+//   surfaces found among them are served directly from their tilar archives
+//   instead of being downloaded
+// the url templates of these surfaces are rewritten to the tilar:// scheme
+//   and the resources bypass the disk cache
+// all methods are thread safe
+class LocalTilesets : private Immovable
+{
+public:
+    void initialize(const std::string &path);
+
+    // reads the configs of the tilesets that were not loaded yet
+    //   call it from a decoder thread, the configs are read from the disk
+    void load(const std::vector<std::string> &tilesetIds);
+
+    // rewrites the url templates of the surface
+    //   returns false if the tileset is not available locally
+    bool resolve(const std::string &tilesetId, UrlTemplate &meta,
+        UrlTemplate &mesh, UrlTemplate &texture);
+
+    // reads the resource using positional reads
+    //   throws if the resource is missing
+    Buffer read(const std::string &name);
+
+    static bool owns(const std::string &name);
+
+private:
+    class Archive;
+    class Tileset;
+
+    std::shared_ptr<Tileset> loadTileset(const std::string &tilesetId);
+    std::shared_ptr<Archive> archive(const std::string &path,
+        uint32 filesPerTile, uint32 binaryOrder);
+
+    std::string root;
+    // null for tilesets that are not available locally
+    std::map<std::string, std::shared_ptr<Tileset>> tilesets;
+    // recently used archives, the least recent are closed first
+    std::map<std::string, std::shared_ptr<Archive>> archives;
+    uint64 archivesUseIndex = 0;
+    std::mutex mut;
+};
+
+} // namespace vts
+
+#endif
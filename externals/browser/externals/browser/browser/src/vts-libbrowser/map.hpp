@@ -35,6 +35,7 @@
 #include <memory>
 
 #include <vts-libs/registry/referenceframe.hpp>
+#include <vts-libs/vts/urltemplate.hpp>
 
 #include "include/vts-browser/mapStatistics.hpp"
 #include "include/vts-browser/mapOptions.hpp"
@@ -44,7 +45,10 @@
 #include "include/vts-browser/buffer.hpp"
 
 #include "utilities/threadQueue.hpp"
+#include "resource.hpp"
 #include "validity.hpp"
+#include "downloadThrottle.hpp"
+#include "localTilesets.hpp"
 
 #include <boost/container/small_vector.hpp>
 
@@ -72,7 +76,6 @@ class TilesetMapping;
 class GeodataFeatures;
 class GeodataStylesheet;
 class GeodataTile;
-class Resource;
 class TraverseNode;
 class Credits;
 class FetchTaskImpl;
@@ -80,6 +83,30 @@ class GpuFont;
 class Cache;
 
 using TileId = vtslibs::registry::ReferenceFrame::Division::Node::Id;
+using vtslibs::vts::UrlTemplate;
+
+// identification of a resource generated from an url template
+//   it allows to find the resource without formatting the url
+//   it holds all the variables that the template may expand
+class ResourceKey
+{
+public:
+    ResourceKey(const UrlTemplate *urlTemplate, const UrlTemplate::Vars &vars);
+    bool operator == (const ResourceKey &other) const;
+
+    const UrlTemplate *urlTemplate;
+    TileId tileId;
+    TileId localId;
+    uint32 subMesh;
+    std::string srs;
+    std::string rf;
+    std::vector<std::string> params;
+};
+
+struct ResourceKeyHash
+{
+    std::size_t operator()(const ResourceKey &key) const;
+};
 
 class CacheData
 {
@@ -89,8 +116,12 @@ public:
 
     Buffer buffer;
     std::string name;
+    std::string etag;
     sint64 expires = 0;
+    sint64 lastModified = -1;
     bool availFailed = false;
+    bool notFound = false; // the resource is missing on the server
+    bool stale = false; // expired, must be revalidated before use
 };
 
 class UploadData
@@ -107,10 +138,42 @@ public:
     void process();
 
 protected:
+    friend bool threadQueuePriority(const UploadData &data, float &priority);
     std::weak_ptr<Resource> uploadData;
     std::shared_ptr<void> destroyData;
 };
 
+// resource waiting for a download
+//   it is dropped from the queue when it leaves the startDownload state
+class DownloadRequest
+{
+public:
+    DownloadRequest();
+    explicit DownloadRequest(const std::shared_ptr<Resource> &resource);
+
+    std::weak_ptr<Resource> resource;
+};
+
+// resource waiting for a read from the disk cache
+//   or a name of a cache entry to read ahead, with the lowest priority
+class CacheReadRequest
+{
+public:
+    CacheReadRequest();
+    explicit CacheReadRequest(const std::shared_ptr<Resource> &resource);
+    explicit CacheReadRequest(const std::string &readAhead);
+
+    std::weak_ptr<Resource> resource;
+    std::string readAhead;
+};
+
+// priorities for use in ThreadPriorityQueue
+bool threadQueuePriority(const std::weak_ptr<Resource> &resource,
+    float &priority);
+bool threadQueuePriority(const DownloadRequest &data, float &priority);
+bool threadQueuePriority(const CacheReadRequest &data, float &priority);
+bool threadQueuePriority(const UploadData &data, float &priority);
+
 class MapImpl : private Immovable
 {
 public:
@@ -121,23 +184,82 @@ public:
         std::shared_ptr<Cache> cache;
         std::shared_ptr<AuthConfig> auth;
         std::unordered_map<std::string, std::shared_ptr<Resource>> resources;
+        // secondary index of resources generated from url templates
+        //   (it must be cleared whenever any of the templates is destroyed)
+        std::unordered_map<ResourceKey, std::weak_ptr<Resource>,
+            ResourceKeyHash> resourcesByKey;
         std::list<std::weak_ptr<SearchTask>> searchTasks;
         std::string authPath;
         std::atomic<uint32> downloads{0}; // number of active downloads
         std::condition_variable downloadsCondition;
+        std::mutex downloadsMutex;
+        // resources whose hosts reached their limit of downloads
+        //   they are returned to the queue when any download finishes
+        std::vector<DownloadRequest> downloadsBlocked;
+        // resources handed to the fetcher
+        //   (checked in the render thread for downloads to cancel)
+        std::vector<std::weak_ptr<Resource>> downloadsInFlight;
+        std::mutex downloadsInFlightMutex;
+        DownloadThrottle downloadThrottle;
+        // statistics counted outside the render thread, see MapStatistics
+        //   copied into the statistics in the render thread
+        struct Counters
+        {
+            std::atomic<uint32> resourcesDiskLoaded{0};
+            std::atomic<uint32> resourcesLocalLoaded{0};
+            std::atomic<uint32> resourcesDecoded{0};
+            std::atomic<uint32> resourcesFailed{0};
+            std::atomic<uint32> resourcesCancelled{0};
+            std::atomic<uint32> resourcesRevalidated{0};
+            std::atomic<uint64> downloadedBytesTransferred
+                [FetchTask::ResourceTypesCount] {};
+            std::atomic<uint64> downloadedBytesDecoded
+                [FetchTask::ResourceTypesCount] {};
+        } counters;
+        // histograms of the download phases, see MapStatistics
+        //   recorded in the fetch threads
+        //   and copied into the statistics in the render thread
+        std::atomic<uint32> downloadLatency[FetchTask::ResourceTypesCount]
+            [MapStatistics::DownloadPhasesCount]
+            [MapStatistics::DownloadLatencyBuckets] {};
+        LocalTilesets localTilesets;
         uint32 progressEstimationMaxResources = 0;
 
-        ThreadQueue<std::weak_ptr<Resource>> queFetching;
+        // number of tracked resources in each state
+        std::atomic<uint32> statesCounts[Resource::StatesCount] {};
+        // resources that changed into a state that requires
+        //   further processing in the render thread
+        std::vector<std::weak_ptr<Resource>> stateChanges;
+        std::mutex stateChangesMutex;
+        // resources waiting for initialization, retry, cache read, download
+        //   or removal after a failure (accessed in the render thread only)
+        std::vector<std::weak_ptr<Resource>> pending;
+        // tracked resources ordered by last access, least recent first
+        //   (accessed in the render thread only)
+        std::list<Resource*> lru;
+        // memory used by the tracked resources
+        std::atomic<uint64> ramMemoryUse{0};
+        std::atomic<uint64> gpuMemoryUse{0};
+
+        ThreadPriorityQueue<DownloadRequest> queFetching;
         ThreadQueue<std::weak_ptr<Resource>> queCacheRead;
+        // batch of cache reads distributed among the cache read workers
+        //   followed by the read ahead requests
+        ThreadPriorityQueue<CacheReadRequest> queCacheReadWorkers;
+        std::atomic<uint32> cacheReadsInFlight{0};
+        std::atomic<uint32> cacheReadAheadsQueued{0};
+        std::mutex cacheReadsMutex;
+        std::condition_variable cacheReadsCondition;
         ThreadQueue<CacheData> queCacheWrite;
-        ThreadQueue<std::weak_ptr<Resource>> queDecode;
+        ThreadPriorityQueue<std::weak_ptr<Resource>> queDecode;
         ThreadQueue<std::weak_ptr<GeodataTile>> queGeodata;
         ThreadQueue<std::weak_ptr<GpuAtmosphereDensityTexture>> queAtmosphere;
-        ThreadQueue<UploadData> queUpload;
+        ThreadPriorityQueue<UploadData> queUpload;
         std::thread thrFetcher;
         std::thread thrCacheReader;
+        std::vector<std::thread> thrCacheReadWorkers;
         std::thread thrCacheWriter;
-        std::thread thrDecoder;
+        std::vector<std::thread> thrDecoders;
         std::thread thrGeodataProcessor;
         std::thread thrAtmosphereGenerator;
     } resources;
@@ -190,15 +312,20 @@ public:
     void resourcesDataUpdate();
     void resourcesRenderUpdate();
 
+    void resourceTrack(const std::shared_ptr<Resource> &r);
+    void resourceStateChanged(Resource *r,
+        Resource::State old, Resource::State state);
+    void resourcesCollectPending();
     bool resourcesTryRemove(std::shared_ptr<Resource> &r);
     void resourcesRemoveOld();
     void resourcesCheckInitialized();
     void resourcesStartDownloads();
+    void resourcesCancelDownloads();
     void resourcesDownloadsEntry();
     void resourcesUploadProcessorEntry();
     void resourcesAtmosphereGeneratorEntry();
     void resourcesGeodataProcessorEntry();
-    void resourcesDecodeProcessorEntry();
+    void resourcesDecodeProcessorEntry(uint32 index);
     void resourceDecodeProcess(const std::shared_ptr<Resource> &r);
     void resourceUploadProcess(const std::shared_ptr<Resource> &r);
     void resourceSaveCorruptedFile(const std::shared_ptr<Resource> &r);
@@ -208,27 +335,41 @@ public:
     void cacheWriteEntry();
     void cacheWrite(CacheData &&data);
     void cacheReadEntry();
+    void cacheReadWorkerEntry(uint32 index);
     void cacheReadProcess(const std::shared_ptr<Resource> &r);
+    void cacheReadProcessSafe(const std::shared_ptr<Resource> &r);
     CacheData cacheRead(const std::string &name);
+    bool cacheReadNegative(const std::string &name);
+    void cacheReadAhead(const std::string &name);
     void cachePurge();
+    void cacheMaintenance();
+    void cacheUpdateStatistics();
 
     void touchResource(const std::shared_ptr<Resource> &resource);
     Validity getResourceValidity(const std::string &name);
     Validity getResourceValidity(const std::shared_ptr<Resource> &resource);
 
     std::shared_ptr<GpuTexture> getTexture(const std::string &name);
+    std::shared_ptr<GpuTexture> getTexture(const UrlTemplate &urlTemplate,
+        const UrlTemplate::Vars &vars);
     std::shared_ptr<GpuAtmosphereDensityTexture>
         getAtmosphereDensityTexture(const std::string &name);
     std::shared_ptr<GpuMesh> getMesh(const std::string &name);
     std::shared_ptr<AuthConfig> getAuthConfig(const std::string &name);
     std::shared_ptr<Mapconfig> getMapconfig(const std::string &name);
     std::shared_ptr<MetaTile> getMetaTile(const std::string &name);
+    std::shared_ptr<MetaTile> getMetaTile(const UrlTemplate &urlTemplate,
+        const UrlTemplate::Vars &vars);
     std::shared_ptr<MeshAggregate> getMeshAggregate(const std::string &name);
+    std::shared_ptr<MeshAggregate> getMeshAggregate(
+        const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars);
     std::shared_ptr<ExternalBoundLayer> getExternalBoundLayer(
             const std::string &name);
     std::shared_ptr<ExternalFreeLayer> getExternalFreeLayer(
             const std::string &name);
     std::shared_ptr<BoundMetaTile> getBoundMetaTile(const std::string &name);
+    std::shared_ptr<BoundMetaTile> getBoundMetaTile(
+        const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars);
     std::shared_ptr<SearchTaskImpl> getSearchTask(const std::string &name);
     std::shared_ptr<TilesetMapping> getTilesetMapping(const std::string &name);
     std::shared_ptr<GeodataFeatures> getGeoFeatures(const std::string &name);
@@ -248,6 +389,10 @@ public:
     TileId roundId(TileId nodeId);
 };
 
+// index of the current decoder thread
+//   throws when called from any other thread
+uint32 decoderThreadIndex();
+
 std::string convertPath(const std::string &path,
                         const std::string &parent);
 std::string convertNameToPath(const std::string &path,
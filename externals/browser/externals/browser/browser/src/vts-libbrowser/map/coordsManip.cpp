@@ -98,8 +98,10 @@ class CoordManipImpl : public CoordManip
 public:
     vtslibs::vts::MapConfig &mapconfig;
 
-    std::unordered_map<std::string,
-        std::unique_ptr<vtslibs::vts::CsConvertor>> convertors;
+    // indexed by source srs and then by target srs
+    //   lookups do not allocate any temporary keys
+    std::unordered_map<std::string, std::unordered_map<std::string,
+        std::unique_ptr<vtslibs::vts::CsConvertor>>> convertors;
 
     boost::optional<GeographicLib::Geodesic> geodesic_;
 
@@ -176,13 +178,12 @@ public:
     vtslibs::vts::CsConvertor &convertor(const std::string &a,
                                          const std::string &b)
     {
-        const std::string key = a + " >>> " + b;
-        auto it = convertors.find(key);
-        if (it == convertors.end())
+        auto &targets = convertors[a];
+        auto it = targets.find(b);
+        if (it == targets.end())
         {
-            convertors[key] = std::make_unique<vtslibs::vts::CsConvertor>(
-                a, b, mapconfig, ctx);
-            it = convertors.find(key);
+            it = targets.emplace(b, std::make_unique<
+                vtslibs::vts::CsConvertor>(a, b, mapconfig, ctx)).first;
         }
         return *it->second;
     }
@@ -196,6 +197,17 @@ public:
         //           << "> to <" << res.transpose() << "><" << t << ">";
         return res;
     }
+
+    void convert(vec3 *values, uint32 count,
+        const std::string &f, const std::string &t)
+    {
+        static_assert(sizeof(vec3) == 3 * sizeof(double),
+            "vec3 must be tightly packed");
+        if (count == 0)
+            return;
+        const auto &cs = convertor(f, t);
+        cs(values->data(), count);
+    }
 };
 
 } // namespace
@@ -243,6 +255,19 @@ vec3 CoordManip::convert(const vec3 &value, Srs from, const std::string &to)
     return impl->convert(value, impl->srsToProj(from), to);
 }
 
+void CoordManip::convert(vec3 *values, uint32 count, Srs from, Srs to)
+{
+    CoordManipImpl *impl = (CoordManipImpl *)this;
+    impl->convert(values, count, impl->srsToProj(from), impl->srsToProj(to));
+}
+
+void CoordManip::convert(vec3 *values, uint32 count,
+    const std::string &from, Srs to)
+{
+    CoordManipImpl *impl = (CoordManipImpl *)this;
+    impl->convert(values, count, from, impl->srsToProj(to));
+}
+
 vec3 CoordManip::geoDirect(const vec3 &position, double distance,
     double azimuthIn, double &azimuthOut)
 {
@@ -44,25 +44,50 @@
 namespace vts
 {
 
+namespace
+{
+
+uint32 decoderThreadsCount(const MapCreateOptions &options)
+{
+    if (options.decodeThreads > 0)
+        return options.decodeThreads;
+    // leave some cores for the render and data threads
+    uint32 hc = std::thread::hardware_concurrency();
+    return hc > 3 ? hc - 2 : 1;
+}
+
+} // namespace
+
 MapImpl::MapImpl(Map *map, const MapCreateOptions &options,
     const std::shared_ptr<Fetcher> &fetcher) :
     map(map), createOptions(options)
 {
     assert(fetcher);
     resources.fetcher = fetcher;
+    cacheInit(); // before the threads start
+    resources.localTilesets.initialize(options.localTilesetsPath);
     resources.thrFetcher
         = std::thread(&MapImpl::resourcesDownloadsEntry, this);
     resources.thrCacheReader
         = std::thread(&MapImpl::cacheReadEntry, this);
     resources.thrCacheWriter
         = std::thread(&MapImpl::cacheWriteEntry, this);
-    resources.thrDecoder
-        = std::thread(&MapImpl::resourcesDecodeProcessorEntry, this);
+    resources.thrCacheReadWorkers.resize(options.cacheReadThreads);
+    for (uint32 i = 0; i < options.cacheReadThreads; i++)
+    {
+        resources.thrCacheReadWorkers[i]
+            = std::thread(&MapImpl::cacheReadWorkerEntry, this, i);
+    }
+    resources.thrDecoders.resize(decoderThreadsCount(options));
+    for (uint32 i = 0, e = resources.thrDecoders.size(); i < e; i++)
+    {
+        resources.thrDecoders[i]
+            = std::thread(&MapImpl::resourcesDecodeProcessorEntry, this, i);
+    }
     resources.thrGeodataProcessor
         = std::thread(&MapImpl::resourcesGeodataProcessorEntry, this);
     resources.thrAtmosphereGenerator
         = std::thread(&MapImpl::resourcesAtmosphereGeneratorEntry, this);
-    cacheInit();
     credits = std::make_shared<Credits>();
 }
 
@@ -72,7 +97,10 @@ MapImpl::~MapImpl()
     resources.thrFetcher.join();
     resources.thrCacheReader.join();
     resources.thrCacheWriter.join();
-    resources.thrDecoder.join();
+    for (std::thread &it : resources.thrCacheReadWorkers)
+        it.join();
+    for (std::thread &it : resources.thrDecoders)
+        it.join();
     resources.thrAtmosphereGenerator.join();
     resources.thrGeodataProcessor.join();
 }
@@ -167,6 +195,9 @@ void MapImpl::purgeViewCache()
     mapconfigReady = false;
     mapconfigView = "";
     layers.clear();
+    // the url templates used as keys are owned by the layers
+    //   and by the bound infos in the mapconfig
+    resources.resourcesByKey.clear();
 
     for (auto &camera : cameras)
     {
@@ -222,6 +253,10 @@ bool MapImpl::prerequisitesCheck()
 
     if (!mapconfigAvailable)
     {
+        // the mapconfig may have been decoded again
+        //   and the bound infos rebuilt with new url templates
+        resources.resourcesByKey.clear();
+
         convertor = CoordManip::create(
             *mapconfig,
             mapconfig->browserOptions.searchSrs,
@@ -81,6 +81,8 @@ void SurfaceStack::generateTileset(MapImpl *map,
                     *mapconfig->findSurface(vsId[it[0]]),
                     mapconfig->name);
             i.name.push_back(vsId[it[0]]);
+            map->resources.localTilesets.resolve(vsId[it[0]],
+                    i.urlMeta, i.urlMesh, i.urlIntTex);
             surfaces.push_back(i);
         }
         else
@@ -155,6 +157,8 @@ void SurfaceStack::generateReal(MapImpl *map)
                     *map->mapconfig->findSurface(ts.tilesetId),
                     map->mapconfig->name);
         i.name = { ts.tilesetId };
+        map->resources.localTilesets.resolve(ts.tilesetId,
+                    i.urlMeta, i.urlMesh, i.urlIntTex);
         surfaces.push_back(i);
     }
 
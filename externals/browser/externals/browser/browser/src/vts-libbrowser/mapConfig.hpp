@@ -28,11 +28,13 @@
 #define MAPCONFIG_HPP_sdf45gde5g4
 
 #include <unordered_map>
+#include <shared_mutex>
 
 #include <vts-libs/vts/nodeinfo.hpp>
 #include <vts-libs/vts/mapconfig.hpp>
 
 #include "resource.hpp"
+#include "hashTileId.hpp"
 
 namespace Json
 {
@@ -96,7 +98,15 @@ public:
 
     BrowserOptions browserOptions;
     std::vector<vtslibs::vts::NodeInfo> referenceDivisionNodeInfos;
-    std::shared_ptr<CoordManip> convertorData; // used in data/decoder thread
+    // index into referenceDivisionNodeInfos by the node id
+    std::unordered_map<vtslibs::vts::TileId, uint32>
+        referenceDivisionNodeIndices;
+    // convertors for use in decoder threads, one for each thread
+    std::vector<std::shared_ptr<CoordManip>> convertorsData;
+    // the mapconfig is decoded in place, possibly again after a purge
+    //   while other decoder threads use it
+    // hold it shared while reading the mapconfig from the metatiles
+    std::shared_timed_mutex decodeMutex;
     std::string atmosphereDensityTextureName;
 
 private:
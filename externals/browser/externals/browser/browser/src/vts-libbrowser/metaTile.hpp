@@ -54,10 +54,16 @@ public:
 class MetaNode
 {
 public:
+    // oriented bounding box
+    //   stored in single precision relative to its center
     struct Obb
     {
-        mat4 rotInv;
-        vec3 points[2];
+        mat3f axes; // columns are the box axes in physical srs
+        vec3 center;
+        vec3f points[2]; // box corners along its axes
+
+        // transformation from the box space to the physical srs
+        mat4 rotInv() const;
     };
 
     TileId tileId;
@@ -67,9 +73,9 @@ public:
     boost::optional<Obb> obb;
     boost::optional<vec3> surrogatePhys;
     boost::optional<float> surrogateNav;
-    vec3 diskNormalPhys;
+    vec3f diskNormalPhys;
     vec2 diskHeightsPhys;
-    double diskHalfAngle;
+    float diskHalfAngle;
     double texelSize;
 
     MetaNode();
@@ -84,6 +90,13 @@ MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
 MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
     const std::shared_ptr<CoordManip> &cnv,
     const vtslibs::vts::TileId &id, const vtslibs::vts::MetaNode &meta);
+// generates count metanodes at once
+//   coordinates of all the nodes are converted together in few batches
+void generateMetaNodes(const std::shared_ptr<Mapconfig> &m,
+    const std::shared_ptr<CoordManip> &cnv,
+    const vtslibs::vts::TileId *ids,
+    const vtslibs::vts::MetaNode *const *metas,
+    MetaNode *nodes, uint32 count);
 
 class MetaTile : public Resource, public vtslibs::vts::MetaTile
 {
@@ -91,11 +104,13 @@ public:
     MetaTile(MapImpl *map, const std::string &name);
     void decode() override;
     FetchTask::ResourceType resourceType() const override;
+    // the metanodes are generated on first access
+    //   call from the render thread only
     std::shared_ptr<const MetaNode> getNode(const TileId &tileId);
 
 private:
     std::weak_ptr<Mapconfig> mapconfig;
-    std::vector<boost::optional<MetaNode>> metas;
+    std::vector<std::unique_ptr<MetaNode>> metas;
 };
 
 } // namespace vts
@@ -0,0 +1,81 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NEGATIVECACHE_HPP_k3d9f1w5e2
+#define NEGATIVECACHE_HPP_k3d9f1w5e2
+
+#include <map>
+#include <mutex>
+#include <string>
+
+#include "packedCache.hpp"
+
+namespace vts
+{
+
+// persistent set of resources that are known to be missing on the server
+//   the resources are identified by md5 digest of their names
+//   and are kept in a single file, sorted by the digest
+// all methods are thread safe
+class NegativeCache : private Immovable
+{
+public:
+    typedef PackedCache::Digest Digest;
+
+    // loads the file, if it exists, expired entries are dropped
+    explicit NegativeCache(const std::string &path);
+
+    // saves the modifications
+    ~NegativeCache();
+
+    // expired entries are removed on access
+    bool contains(const Digest &digest);
+
+    // expires is unix time
+    void insert(const Digest &digest, sint64 expires);
+
+    void remove(const Digest &digest);
+
+    // writes the file if it was modified
+    void save();
+
+    // remove all entries, including the file
+    void purge();
+
+    uint32 size();
+
+private:
+    void saveLocked();
+
+    const std::string path;
+    std::map<Digest, sint64> entries;
+    std::mutex mut;
+    bool modified = false;
+};
+
+} // namespace vts
+
+#endif
@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PACKEDCACHE_HPP_g5s4e6r8t7
+#define PACKEDCACHE_HPP_g5s4e6r8t7
+
+#include <array>
+#include <string>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "include/vts-browser/foundation.hpp"
+
+namespace vts
+{
+
+// disk cache storage with all records packed in few large segment files
+//   the records are found by md5 digest in a memory mapped hash index
+//   and are read directly from memory mapped segments
+// all methods are thread safe
+class PackedCache : private Immovable
+{
+    // this class is just an interface
+    //  - do not instantiate it directly - use the create method instead
+    //  - do not inherit from it
+public:
+    typedef std::array<unsigned char, 16> Digest;
+
+    // a piece of data to be written, pointer and size
+    typedef std::pair<const void *, uint32> Part;
+
+    // a view into a mapped segment
+    //   the owner keeps the segment mapped
+    struct Record
+    {
+        const char *data = nullptr;
+        uint32 size = 0;
+        std::shared_ptr<const void> owner;
+    };
+
+    // throws if the directory cannot be locked for exclusive use
+    static std::shared_ptr<PackedCache> create(const std::string &path);
+
+    // returns empty record if the digest is not stored
+    Record read(const Digest &digest);
+
+    // stores concatenation of the parts, replacing previous record, if any
+    //   the record may be evicted after the expires time (unix time, if positive)
+    // returns false if there is no space on the disk, nothing is written
+    bool write(const Digest &digest, const std::vector<Part> &parts,
+        sint64 expires);
+
+    void remove(const Digest &digest);
+
+    // move live records out of segments that are mostly garbage
+    //   the amount of work in one call is bounded
+    void compact();
+
+    // remove expired records
+    //   and least recently accessed records until the size of live records
+    //   is below the target
+    // returns number of evicted records
+    uint32 evict(uint64 targetSize);
+
+    // bytes occupied on the disk
+    uint64 size();
+
+    // remove all records
+    void purge();
+};
+
+} // namespace vts
+
+#endif
@@ -29,6 +29,7 @@
 
 #include <memory>
 #include <string>
+#include <list>
 #include <atomic>
 #include <ctime>
 
@@ -58,6 +59,20 @@ public:
         errorRetry,
         availFail,
     };
+    static const uint32 StatesCount = (uint32)State::availFail + 1;
+
+    // atomic state that notifies the map about its changes
+    class AtomicState : private Immovable
+    {
+    public:
+        explicit AtomicState(Resource *resource);
+        AtomicState &operator = (State s);
+        operator State () const { return value; }
+
+    private:
+        Resource *const resource;
+        std::atomic<State> value {State::initializing};
+    };
 
     explicit Resource(MapImpl *map, const std::string &name);
     virtual ~Resource();
@@ -75,7 +90,7 @@ public:
 
     const std::string name;
     MapImpl *const map = nullptr;
-    std::atomic<State> state {State::initializing};
+    AtomicState state;
     ResourceInfo info;
     std::shared_ptr<void> decodeData;
     std::shared_ptr<FetchTaskImpl> fetch;
@@ -83,6 +98,17 @@ public:
     uint32 retryNumber = 0;
     uint32 lastAccessTick = 0;
     float priority;
+    // priority accumulated over the last update period
+    //   while the resource waits for a download
+    float fetchPriority = 0;
+    bool tracked = false; // registered in the map resources
+    std::atomic<bool> pending {false}; // listed in the map pending resources
+    std::list<Resource*>::iterator lruPosition; // valid when tracked
+    uint32 ramMemoryAccounted = 0; // memory included in the map totals
+    uint32 gpuMemoryAccounted = 0;
+    // names of resources that are likely to be requested soon
+    //   they are read ahead from the disk cache when this one is read
+    std::vector<std::string> readAhead;
 };
 
 std::ostream &operator << (std::ostream &stream, Resource::State state);
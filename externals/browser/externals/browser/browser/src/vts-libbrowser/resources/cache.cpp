@@ -26,6 +26,8 @@
 
 #include "../include/vts-browser/mapOptions.hpp"
 #include "../map.hpp"
+#include "../packedCache.hpp"
+#include "../negativeCache.hpp"
 
 #include <boost/filesystem.hpp>
 #include <utility/path.hpp> // homeDir
@@ -33,6 +35,14 @@
 #include <dbglog/dbglog.hpp>
 #include <optick.h>
 
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+#include <deque>
+#include <fstream>
+#include <unordered_set>
+
 namespace vts
 {
 
@@ -40,7 +50,10 @@ namespace
 {
 
 static const char Magic[] = "vtscache";
-static const uint16 Version = 4;
+static const uint16 Version = 5;
+static const char PackedDirName[] = "vtspack";
+static const char NegativeFileName[] = "vtsnegative";
+static const uint32 ReadAheadCapacity = 128;
 
 enum class CacheFlags : uint16
 {
@@ -55,8 +68,14 @@ struct CacheHeader
     uint16 flags;
     uint16 nameLen;
     sint64 expires;
+    // version 5
+    sint64 lastModified;
+    uint16 etagLen;
 };
 
+// version 4 headers end before the validators
+static const uint32 HeaderSizeV4 = offsetof(CacheHeader, lastModified);
+
 char digit(unsigned char a)
 {
     assert(a < 16);
@@ -71,8 +90,12 @@ class Cache
 {
 public:
     Cache(const MapCreateOptions &options) :
+        root(options.cachePath),
+        maxSize(uint64(options.diskCacheMaxSizeMB) * 1024 * 1024),
+        negativeExpiration(options.negativeCacheExpiration),
         disabled(!options.diskCache),
-        hashes(options.hashCachePaths)
+        hashes(options.hashCachePaths),
+        legacy(false)
     {
         if (options.diskCache)
         {
@@ -94,87 +117,422 @@ public:
             if (root.back() != '/')
                 root += "/";
             LOG(info2) << "Disk cache path: <" << root << ">";
+            if (options.packedDiskCache)
+                openPacked();
+            if (negativeExpiration > 0)
+            {
+                negative = std::make_shared<NegativeCache>(
+                    root + NegativeFileName);
+            }
 #endif
         }
     }
 
+    void openPacked()
+    {
+        try
+        {
+            std::shared_ptr<PackedCache> p
+                = PackedCache::create(root + PackedDirName);
+            legacy = legacyPresent();
+            if (legacy)
+            {
+                LOG(info2) << "Disk cache entries will be migrated "
+                    "into the packed cache when accessed";
+            }
+            // else there is nothing to index
+            legacyIndexed = !legacy;
+            std::atomic_store(&packed, p);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(warn3) << "Failed to open packed disk cache, "
+                "using individual files instead, <" << e.what() << ">";
+        }
+    }
+
+    // any other content in the root is considered
+    //   to be the cache in the individual files layout
+    bool legacyPresent()
+    {
+        for (const auto &it : boost::filesystem::directory_iterator(root))
+        {
+            if (it.path().filename() != PackedDirName
+                && it.path().filename() != NegativeFileName)
+                return true;
+        }
+        return false;
+    }
+
+    void fillHeader(CacheHeader &h, const CacheData &cd,
+        const std::string &name)
+    {
+        memset(&h, 0, sizeof(CacheHeader)); // initialize structure padding
+        memcpy(h.magic, Magic, sizeof(Magic));
+        h.version = Version;
+        if (cd.availFailed)
+            h.flags |= (uint16)CacheFlags::AvailFailed;
+        h.expires = cd.expires;
+        h.nameLen = name.size();
+        h.lastModified = cd.lastModified;
+        h.etagLen = cd.etag.size();
+    }
+
+    // validates the record and extracts the payload
+    //   the payload refers to the memory of the owner
+    CacheData parse(const char *data, uint32 dataSize,
+        const std::shared_ptr<const void> &owner,
+        const std::string &name, const std::string &nameParam,
+        bool &expired)
+    {
+        expired = false;
+        if (dataSize < HeaderSizeV4)
+            return {};
+        CacheHeader h;
+        memset(&h, 0, sizeof(CacheHeader));
+        memcpy(&h, data, HeaderSizeV4);
+        if (memcmp(h.magic, Magic, sizeof(Magic)) != 0)
+            return {};
+        uint32 headerSize = 0;
+        switch (h.version)
+        {
+        case 4: // no validators
+            headerSize = HeaderSizeV4;
+            h.lastModified = -1;
+            break;
+        case Version:
+            headerSize = sizeof(CacheHeader);
+            if (dataSize < headerSize)
+                return {};
+            memcpy(&h, data, headerSize);
+            break;
+        default:
+            return {};
+        }
+        if (name.size() != h.nameLen)
+            return {};
+        if (dataSize < headerSize + h.nameLen + h.etagLen)
+            return {};
+        if (memcmp(data + headerSize,
+            name.data(), h.nameLen) != 0)
+            return {};
+        CacheData cd;
+        cd.expires = h.expires;
+        cd.lastModified = h.lastModified;
+        cd.etag = std::string(data + headerSize + h.nameLen, h.etagLen);
+        bool validators = !cd.etag.empty() || cd.lastModified >= 0;
+        if (cd.expires == -2 || (cd.expires > 0
+            && cd.expires < std::time(nullptr)))
+        {
+            // expired entries with validators are kept for revalidation
+            if (!validators)
+            {
+                expired = cd.expires != -2;
+                return {};
+            }
+            cd.stale = true;
+        }
+        uint32 offset = headerSize + h.nameLen + h.etagLen;
+        uint32 size = dataSize - offset;
+        if (size > 0)
+            cd.buffer = Buffer::wrap(data + offset, size, owner);
+        cd.availFailed = (h.flags & (uint16)CacheFlags::AvailFailed)
+            == (uint16)CacheFlags::AvailFailed;
+        cd.name = nameParam;
+        return cd;
+    }
+
+    // lists the files in the individual files layout
+    //   so that misses in the packed cache do not probe the disk
+    // called in the cache writer thread
+    void indexLegacy()
+    {
+        std::unordered_set<std::size_t> files;
+        const std::string packedPath = root + PackedDirName;
+        const std::string negativePath = root + NegativeFileName;
+        std::hash<std::string> hash;
+        for (boost::filesystem::recursive_directory_iterator
+            it(root), e; it != e; it++)
+        {
+            const std::string path = it->path().string();
+            if (path == packedPath)
+            {
+                it.no_push();
+                continue;
+            }
+            if (path != negativePath
+                && boost::filesystem::is_regular_file(it->status()))
+                files.insert(hash(path.substr(root.size())));
+        }
+        LOG(info2) << "Disk cache has " << files.size()
+            << " entries to migrate into the packed cache";
+        std::lock_guard<std::mutex> lock(legacyMutex);
+        legacyFiles.swap(files);
+        legacyIndexed = true;
+        if (legacyFiles.empty())
+            legacy = false;
+    }
+
+    // moves the entry from individual file into the packed cache
+    PackedCache::Record migrate(PackedCache *p,
+        const PackedCache::Digest &digest, const std::string &name)
+    {
+        std::string fileName = convertNameToCache(name);
+        if (legacyIndexed)
+        {
+            // the files list may contain hash collisions
+            //   those are just probed for nothing
+            std::lock_guard<std::mutex> lock(legacyMutex);
+            if (!legacyFiles.erase(std::hash<std::string>()(
+                fileName.substr(root.size()))))
+                return {};
+            if (legacyFiles.empty())
+            {
+                LOG(info2) << "Disk cache migration has finished";
+                legacy = false;
+            }
+        }
+        if (!boost::filesystem::exists(fileName))
+            return {};
+        {
+            Buffer b = readLocalFileBuffer(fileName);
+            CacheHeader h;
+            memset(&h, 0, sizeof(CacheHeader));
+            if (b.size() >= sizeof(CacheHeader))
+                memcpy(&h, b.data(), sizeof(CacheHeader));
+            if (!p->write(digest, { { b.data(), b.size() } }, h.expires))
+                return {}; // the disk is full, keep the file
+        }
+        boost::system::error_code ec;
+        boost::filesystem::remove(fileName, ec);
+        // remove the directories if they became empty
+        boost::filesystem::path dir
+            = boost::filesystem::path(fileName).parent_path();
+        for (int i = 0; i < 2 && dir.string().size() > root.size(); i++)
+        {
+            if (!boost::filesystem::remove(dir, ec))
+                break;
+            dir = dir.parent_path();
+        }
+        return p->read(digest);
+    }
+
     void write(CacheData &&cd)
     {
 #ifndef __EMSCRIPTEN__
         if (disabled)
             return;
         OPTICK_EVENT();
+        {
+            std::lock_guard<std::mutex> lock(readAheadMutex);
+            readAheadData.erase(cd.name);
+        }
         try
         {
             std::string name = stripScheme(cd.name);
-            Buffer b(sizeof(CacheHeader) + name.size() + cd.buffer.size());
-            memset(b.data(), 0, sizeof(CacheHeader)); // initialize structure padding
-            CacheHeader *h = (CacheHeader*)b.data();
-            memcpy(h->magic, Magic, sizeof(Magic));
-            h->version = Version;
-            if (cd.availFailed)
-                h->flags |= (uint16)CacheFlags::AvailFailed;
-            h->expires = cd.expires;
-            h->nameLen = name.size();
-            memcpy(b.data() + sizeof(CacheHeader), name.data(), name.size());
-            memcpy(b.data() + sizeof(CacheHeader) + name.size(),
-                cd.buffer.data(), cd.buffer.size());
-            writeLocalFileBuffer(convertNameToCache(name), b);
+            if (negative)
+            {
+                if (cd.notFound)
+                {
+                    writeNegative(digest(name), cd.expires);
+                    return;
+                }
+                negative->remove(digest(name));
+            }
+            else if (cd.notFound)
+                return;
+            CacheHeader h;
+            fillHeader(h, cd, name);
+            // the parts are written without concatenating them first
+            const std::vector<PackedCache::Part> parts = {
+                { &h, sizeof(CacheHeader) },
+                { name.data(), (uint32)name.size() },
+                { cd.etag.data(), (uint32)cd.etag.size() },
+                { cd.buffer.data(), cd.buffer.size() } };
+            // entries with validators are kept after they expire
+            //   so that they can be revalidated
+            const bool validators = !cd.etag.empty() || cd.lastModified >= 0;
+            const sint64 expires = validators ? -1 : cd.expires;
+            std::shared_ptr<PackedCache> p = std::atomic_load(&packed);
+            if (p)
+            {
+                if (!p->write(digest(name), parts, expires))
+                {
+                    // the disk is full, keep the cache below its current size
+                    const uint64 s = p->size();
+                    if (maxSize == 0 || s < maxSize)
+                    {
+                        LOG(warn3) << "The disk is full, limiting the disk "
+                            "cache to " << (s / 1024 / 1024) << " MB";
+                        maxSize = s;
+                    }
+                    evictions += p->evict(s / 10 * 9);
+                    size = p->size();
+                    return;
+                }
+                if (maxSize > 0 && p->size() > maxSize)
+                    maintenance();
+                return;
+            }
+            const std::string fileName = convertNameToCache(name);
+            // the entry may be overwritten, eg. after revalidation
+            const uint64 oldSize = fileSize(fileName);
+            detail::writeLocalFileParts(fileName, parts);
+            const uint64 newSize = sizeof(CacheHeader) + name.size()
+                + cd.etag.size() + cd.buffer.size();
+            fileUpdated(fileName, newSize, std::time(nullptr), expires);
+            size += newSize;
+            size -= std::min<uint64>(oldSize, size);
+            if (maxSize > 0 && size > maxSize)
+                maintenance();
         }
-        catch (...)
+        catch (const std::exception &e)
         {
-            // do nothing
+            LOG(warn2) << "Failed to write <" << cd.name
+                << "> into disk cache, <" << e.what() << ">";
         }
 #endif
     }
 
-    CacheData read(const std::string &nameParam)
+    void writeNegative(const PackedCache::Digest &d, sint64 expires)
+    {
+        if (expires == -2)
+            return; // must revalidate
+        std::time_t now = std::time(nullptr);
+        if (expires <= now)
+            expires = now + negativeExpiration;
+        negative->insert(d, expires);
+        // save occasionally so that the entries survive a crash
+        if (now >= negativeSaveTime)
+        {
+            negative->save();
+            negativeSaveTime = now + 60;
+        }
+    }
+
+    // returns true if the resource is known to be missing on the server
+    bool readNegative(const std::string &name)
+    {
+        if (disabled || !negative)
+            return false;
+        if (!negative->contains(digest(stripScheme(name))))
+            return false;
+        negativeHits++;
+        return true;
+    }
+
+    CacheData read(const std::string &name)
     {
-#ifdef __EMSCRIPTEN__
-        return {};
-#else
         if (disabled)
             return {};
         OPTICK_EVENT();
+        const auto start = std::chrono::steady_clock::now();
+        CacheData cd;
+        if (!takeReadAhead(name, cd))
+            cd = readDisk(name);
+        if (cd.name.empty())
+            misses++;
+        else
+            hits++;
+        uint64 us = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start).count();
+        uint32 bucket = 0;
+        while (bucket + 1 < MapStatistics::DiskCacheReadLatencyBuckets
+            && us >= (uint64(64) << bucket))
+            bucket++;
+        readLatency[bucket]++;
+        return cd;
+    }
+
+    // keep the entry in memory until it is read
+    void readAhead(const std::string &name)
+    {
+        if (disabled)
+            return;
+        OPTICK_EVENT();
+        {
+            std::lock_guard<std::mutex> lock(readAheadMutex);
+            if (readAheadData.count(name))
+                return;
+        }
+        CacheData cd = readDisk(name);
+        if (cd.name.empty())
+            return;
+        std::lock_guard<std::mutex> lock(readAheadMutex);
+        uint64 index = readAheadIndex++;
+        readAheadData[name] = std::make_pair(std::move(cd), index);
+        readAheadOrder.emplace_back(name, index);
+        while (readAheadOrder.size() > ReadAheadCapacity)
+        {
+            auto it = readAheadData.find(readAheadOrder.front().first);
+            if (it != readAheadData.end()
+                && it->second.second == readAheadOrder.front().second)
+                readAheadData.erase(it);
+            readAheadOrder.pop_front();
+        }
+    }
+
+    bool takeReadAhead(const std::string &name, CacheData &cd)
+    {
+        std::lock_guard<std::mutex> lock(readAheadMutex);
+        auto it = readAheadData.find(name);
+        if (it == readAheadData.end())
+            return false;
+        cd = std::move(it->second.first);
+        readAheadData.erase(it);
+        return true;
+    }
+
+    CacheData readDisk(const std::string &nameParam)
+    {
+#ifdef __EMSCRIPTEN__
+        return {};
+#else
         std::string name = stripScheme(nameParam);
-        std::string fileName = convertNameToCache(name);
-        if (!boost::filesystem::exists(fileName))
-            return {};
         try
         {
-            CacheData cd;
-            Buffer b = readLocalFileBuffer(fileName);
-            if (b.size() < sizeof(CacheHeader))
-                return {};
-            CacheHeader *h = (CacheHeader*)b.data();
-            if (memcmp(h->magic, Magic, sizeof(Magic)) != 0)
-                return {};
-            if (h->version != Version)
-                return {};
-            sint64 &expires = cd.expires;
-            expires = h->expires;
-            if (expires == -2)
-                return {}; // must revalidate
-            if (expires > 0 && expires < std::time(nullptr))
-                return {}; // expired
-            if (name.size() != h->nameLen)
-                return {};
-            if (b.size() < sizeof(CacheHeader) + h->nameLen)
-                return {};
-            if (memcmp(b.data() + sizeof(CacheHeader),
-                name.data(), h->nameLen) != 0)
-                return {};
-            uint32 size = b.size() - sizeof(CacheHeader) - h->nameLen;
-            if (size > 0)
+            std::shared_ptr<PackedCache> p = std::atomic_load(&packed);
+            if (p)
             {
-                cd.buffer.allocate(size);
-                memcpy(cd.buffer.data(), b.data()
-                    + sizeof(CacheHeader) + h->nameLen, size);
+                PackedCache::Digest d = digest(name);
+                PackedCache::Record r = p->read(d);
+                if (!r.data && legacy)
+                    r = migrate(p.get(), d, name);
+                if (!r.data)
+                    return {};
+                bool expired;
+                CacheData cd = parse(r.data, r.size, r.owner,
+                    name, nameParam, expired);
+                if (expired)
+                    p->remove(d);
+                return cd;
+            }
+            else
+            {
+                std::string fileName = convertNameToCache(name);
+                boost::system::error_code ec;
+                std::time_t t = boost::filesystem::last_write_time(
+                    fileName, ec);
+                if (ec)
+                    return {};
+                // the modification time serves as the access time
+                //   for the eviction, update it occasionally
+                std::time_t now = std::time(nullptr);
+                if (maxSize > 0 && t + 3600 < now)
+                {
+                    boost::filesystem::last_write_time(fileName, now, ec);
+                    fileTouched(fileName, now);
+                }
+                // the payload is taken directly from the file buffer
+                auto b = std::make_shared<Buffer>(
+                    readLocalFileBuffer(fileName));
+                bool expired;
+                CacheData cd = parse(b->data(), b->size(), b,
+                    name, nameParam, expired);
+                if (expired && boost::filesystem::remove(fileName, ec))
+                    fileRemoved(fileName);
+                return cd;
             }
-            cd.availFailed = (h->flags & (uint16)CacheFlags::AvailFailed)
-                == (uint16)CacheFlags::AvailFailed;
-            cd.name = nameParam;
-            return cd;
         }
         catch (...)
         {
@@ -183,6 +541,212 @@ public:
 #endif
     }
 
+    // evicts expired and least recently used entries
+    //   when the cache is over the limit
+    // also updates the size of the cache
+    // called in the cache writer thread
+    void maintenance()
+    {
+#ifndef __EMSCRIPTEN__
+        if (disabled)
+            return;
+        OPTICK_EVENT();
+        try
+        {
+            if (negative)
+                negative->save();
+            if (legacy && !legacyIndexed)
+                indexLegacy();
+            const uint64 target = maxSize / 10 * 9;
+            std::shared_ptr<PackedCache> p = std::atomic_load(&packed);
+            if (p)
+            {
+                if (maxSize > 0 && p->size() > maxSize)
+                    evictions += p->evict(target);
+                size = p->size();
+            }
+            else if (maxSize > 0)
+                maintenanceFiles(target);
+        }
+        catch (const std::exception &e)
+        {
+            LOG(warn3) << "Disk cache maintenance failed: <"
+                << e.what() << ">";
+        }
+#endif
+    }
+
+    // size of the file in the individual files layout
+    //   taken from the index when available
+    uint64 fileSize(const std::string &fileName)
+    {
+        {
+            std::lock_guard<std::mutex> lock(filesMutex);
+            if (filesIndexed)
+            {
+                auto it = files.find(fileName.substr(root.size()));
+                return it == files.end() ? 0 : it->second.size;
+            }
+        }
+        boost::system::error_code ec;
+        uint64 s = boost::filesystem::file_size(fileName, ec);
+        return ec ? 0 : s;
+    }
+
+    void fileUpdated(const std::string &fileName, uint64 fileSize,
+        std::time_t time, sint64 expires)
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        if (!filesIndexed)
+            return;
+        FileEntry &f = files[fileName.substr(root.size())];
+        f.size = fileSize;
+        f.time = time;
+        f.expires = expires;
+    }
+
+    // expiration of the file in the individual files layout
+    //   as used for the eviction, taken from its header
+    sint64 fileExpires(const std::string &fileName)
+    {
+        CacheHeader h;
+        memset(&h, 0, sizeof(CacheHeader));
+        std::ifstream f(fileName, std::ios::binary);
+        f.read((char*)&h, sizeof(CacheHeader));
+        const std::streamsize read = f.gcount();
+        if (read < (std::streamsize)HeaderSizeV4
+            || memcmp(h.magic, Magic, sizeof(Magic)) != 0)
+            return -1;
+        switch (h.version)
+        {
+        case 4: // no validators
+            return h.expires;
+        case Version:
+            if (read < (std::streamsize)sizeof(CacheHeader))
+                return -1;
+            // entries with validators are kept after they expire
+            if (h.etagLen > 0 || h.lastModified >= 0)
+                return -1;
+            return h.expires;
+        default:
+            return -1;
+        }
+    }
+
+    void fileTouched(const std::string &fileName, std::time_t time)
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        auto it = files.find(fileName.substr(root.size()));
+        if (it != files.end())
+            it->second.time = time;
+    }
+
+    void fileRemoved(const std::string &fileName)
+    {
+        std::lock_guard<std::mutex> lock(filesMutex);
+        auto it = files.find(fileName.substr(root.size()));
+        if (it == files.end())
+            return;
+        size -= std::min<uint64>(it->second.size, size);
+        files.erase(it);
+    }
+
+    // lists the files once, they are tracked in the index afterwards
+    void indexFiles()
+    {
+        std::unordered_map<std::string, FileEntry> entries;
+        uint64 total = 0;
+        const std::string packedPath = root + PackedDirName;
+        const std::string negativePath = root + NegativeFileName;
+        if (boost::filesystem::exists(root))
+        {
+            for (boost::filesystem::recursive_directory_iterator
+                it(root), e; it != e; it++)
+            {
+                if (!boost::filesystem::is_regular_file(it->status()))
+                    continue;
+                const std::string path = it->path().string();
+                boost::system::error_code ec;
+                FileEntry en;
+                en.size = boost::filesystem::file_size(it->path(), ec);
+                en.time = boost::filesystem::last_write_time(it->path(), ec);
+                if (ec)
+                    continue;
+                total += en.size;
+                // left over packed cache is counted but not evicted
+                if (path.compare(0, packedPath.size(), packedPath) != 0
+                    && path != negativePath)
+                {
+                    en.expires = fileExpires(path);
+                    entries[path.substr(root.size())] = en;
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(filesMutex);
+        files.swap(entries);
+        filesIndexed = true;
+        size = total;
+        LOG(info2) << "Disk cache has " << files.size() << " files, size: "
+            << (total / 1024 / 1024) << " MB";
+    }
+
+    void maintenanceFiles(uint64 target)
+    {
+        if (!filesIndexed)
+            indexFiles();
+        if (size <= maxSize)
+            return;
+
+        // choose all expired files and then the least recently used files
+        std::vector<std::string> victims;
+        {
+            std::lock_guard<std::mutex> lock(filesMutex);
+            typedef std::unordered_map<std::string, FileEntry>
+                ::const_iterator Iterator;
+            const sint64 now = std::time(nullptr);
+            uint64 total = size;
+            std::vector<Iterator> order;
+            order.reserve(files.size());
+            for (auto it = files.cbegin(); it != files.cend(); it++)
+            {
+                const sint64 e = it->second.expires;
+                if (e == -2 || (e > 0 && e < now))
+                {
+                    total -= std::min<uint64>(it->second.size, total);
+                    victims.push_back(it->first);
+                }
+                else
+                    order.push_back(it);
+            }
+            std::sort(order.begin(), order.end(),
+                [](const Iterator &a, const Iterator &b) {
+                    return a->second.time < b->second.time;
+                });
+            for (const Iterator &it : order)
+            {
+                if (total <= target)
+                    break;
+                total -= std::min<uint64>(it->second.size, total);
+                victims.push_back(it->first);
+            }
+        }
+
+        // the files are removed without holding the lock
+        for (const std::string &v : victims)
+        {
+            const std::string path = root + v;
+            boost::system::error_code ec;
+            if (boost::filesystem::remove(path, ec)
+                || !boost::filesystem::exists(path, ec))
+            {
+                fileRemoved(path);
+                evictions++;
+            }
+        }
+        LOG(info2) << "Disk cache evicted files, size: "
+            << (size / 1024 / 1024) << " MB";
+    }
+
     void purge()
     {
 #ifndef __EMSCRIPTEN__
@@ -191,6 +755,35 @@ public:
         OPTICK_EVENT();
         LOG(info2) << "Purging disk cache";
         assert(root.length() > 0 && root[root.length() - 1] == '/');
+        if (negative)
+            negative->purge();
+        std::shared_ptr<PackedCache> p = std::atomic_load(&packed);
+        if (p)
+        {
+            // the packed cache stays opened, remove everything else
+            try
+            {
+                p->purge();
+                for (const auto &it
+                    : boost::filesystem::directory_iterator(root))
+                {
+                    if (it.path().filename() != PackedDirName)
+                        boost::filesystem::remove_all(it.path());
+                }
+                {
+                    std::lock_guard<std::mutex> lock(legacyMutex);
+                    legacyFiles.clear();
+                    legacyIndexed = true;
+                    legacy = false;
+                }
+                size = p->size();
+            }
+            catch (const std::exception &e)
+            {
+                LOG(warn3) << "Purging cache failed: <" << e.what() << ">";
+            }
+            return;
+        }
         std::string op = root.substr(0, root.length() - 1);
         if (!boost::filesystem::exists(op))
             return;
@@ -199,6 +792,9 @@ public:
             std::string np = op + "-deleted";
             boost::filesystem::rename(op, np);
             boost::filesystem::remove_all(np);
+            std::lock_guard<std::mutex> lock(filesMutex);
+            files.clear();
+            size = 0;
         }
         catch (const std::exception &e)
         {
@@ -207,13 +803,20 @@ public:
 #endif
     }
 
+    PackedCache::Digest digest(const std::string &path)
+    {
+        assert(path == stripScheme(path));
+        PackedCache::Digest d;
+        utility::md5::hash(path.data(), path.size(), (char*)d.data());
+        return d;
+    }
+
     std::string convertNameToCache(const std::string &path)
     {
         assert(path == stripScheme(path));
         if (hashes)
         {
-            unsigned char digest[16];
-            utility::md5::hash(path.data(), path.size(), (char*)digest);
+            PackedCache::Digest digest = this->digest(path);
             std::string r = root;
             for (int i = 0; i < 16; i++)
             {
@@ -243,8 +846,42 @@ public:
     }
 
     std::string root;
+    std::shared_ptr<PackedCache> packed; // accessed atomically
+    std::shared_ptr<NegativeCache> negative; // null when disabled
+    // 0 = unlimited, lowered when the disk gets full
+    std::atomic<uint64> maxSize;
+    const uint32 negativeExpiration; // seconds
+    std::time_t negativeSaveTime = 0;
+    std::atomic<uint64> size {0};
+    std::atomic<uint32> evictions {0};
+    std::atomic<uint32> hits {0};
+    std::atomic<uint32> misses {0};
+    std::atomic<uint32> negativeHits {0};
+    std::atomic<uint32> readLatency[MapStatistics::DiskCacheReadLatencyBuckets]
+        {};
+    std::unordered_map<std::string, std::pair<CacheData, uint64>>
+        readAheadData;
+    std::deque<std::pair<std::string, uint64>> readAheadOrder;
+    uint64 readAheadIndex = 0;
+    std::mutex readAheadMutex;
     bool disabled;
     bool hashes;
+    std::atomic<bool> legacy; // entries may need migration
+    struct FileEntry
+    {
+        uint64 size = 0;
+        std::time_t time = 0;
+        sint64 expires = -1; // as in the cache header, -1 = never
+    };
+    // files in the individual files layout, relative to the root
+    //   listed at the first maintenance and then kept up to date
+    std::unordered_map<std::string, FileEntry> files;
+    std::atomic<bool> filesIndexed {false};
+    std::mutex filesMutex;
+    // hashes of paths of the files that were not migrated yet
+    std::unordered_set<std::size_t> legacyFiles;
+    std::atomic<bool> legacyIndexed {false};
+    std::mutex legacyMutex;
 };
 
 void MapImpl::cacheInit()
@@ -262,11 +899,42 @@ CacheData MapImpl::cacheRead(const std::string &name)
     return resources.cache->read(name);
 }
 
+bool MapImpl::cacheReadNegative(const std::string &name)
+{
+    return resources.cache->readNegative(name);
+}
+
+void MapImpl::cacheReadAhead(const std::string &name)
+{
+    resources.cache->readAhead(name);
+}
+
 void MapImpl::cachePurge()
 {
     resources.cache->purge();
 }
 
+void MapImpl::cacheMaintenance()
+{
+    resources.cache->maintenance();
+}
+
+void MapImpl::cacheUpdateStatistics()
+{
+    const Cache &c = *resources.cache;
+    statistics.diskCacheSizeKB = c.size / 1024;
+    statistics.diskCacheEvictions = c.evictions;
+    statistics.diskCacheHits = c.hits;
+    statistics.diskCacheMisses = c.misses;
+    statistics.diskCacheNegativeHits = c.negativeHits;
+    statistics.diskCacheNegativeEntries = c.negative ? c.negative->size() : 0;
+    uint32 total = statistics.diskCacheHits + statistics.diskCacheMisses;
+    statistics.diskCacheHitRate = total > 0
+        ? (double)statistics.diskCacheHits / total : 0;
+    for (uint32 i = 0; i < MapStatistics::DiskCacheReadLatencyBuckets; i++)
+        statistics.diskCacheReadLatency[i] = c.readLatency[i];
+}
+
 std::string convertNameToPath(const std::string &pathParam, bool preserveSlashes)
 {
     std::string path = boost::filesystem::path(pathParam)
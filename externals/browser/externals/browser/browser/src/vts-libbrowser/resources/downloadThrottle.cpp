@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "../downloadThrottle.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace vts
+{
+
+namespace
+{
+
+// the limit never drops below this
+static const double MinLimit = 2;
+// the minimum latency is remeasured after this period
+//   so that the throttle adapts to changes in the route
+static const double MinLatencyWindow = 10;
+// replies delayed more than this are considered queued
+static const double DelayFactor = 1.5;
+static const double DelayTolerance = 0.02; // seconds
+static const double DecreaseFactor = 0.75;
+static const double BandwidthWindow = 1; // seconds
+static const double BandwidthSmoothing = 0.25;
+
+double seconds(DownloadThrottle::Clock::duration d)
+{
+    return std::chrono::duration<double>(d).count();
+}
+
+} // namespace
+
+std::string DownloadThrottle::host(const std::string &url)
+{
+    std::size_t s = url.find("://");
+    s = s == std::string::npos ? 0 : s + 3;
+    std::size_t e = url.find_first_of("/?#", s);
+    return url.substr(s, e == std::string::npos ? e : e - s);
+}
+
+bool DownloadThrottle::acquire(const std::string &host,
+    uint32 initialLimit, bool enforce)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    Host &h = hosts[host];
+    if (h.limit == 0)
+    {
+        h.limit = std::max<double>(initialLimit, MinLimit);
+        h.windowStart = Clock::now();
+    }
+    if (enforce && h.inFlight >= (uint32)h.limit)
+        return false;
+    h.inFlight++;
+    return true;
+}
+
+void DownloadThrottle::release(const std::string &host, double firstByte,
+    double duration, uint64 bytes, bool success, bool delayed,
+    uint32 maxLimit)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    auto it = hosts.find(host);
+    assert(it != hosts.end());
+    Host &h = it->second;
+    assert(h.inFlight > 0);
+    uint32 concurrent = h.inFlight--;
+    Clock::time_point now = Clock::now();
+
+    // delivery rate, smoothed over consecutive windows
+    h.windowBytes += bytes;
+    double window = seconds(now - h.windowStart);
+    if (window >= BandwidthWindow)
+    {
+        double rate = h.windowBytes / window;
+        h.bandwidth = h.bandwidth == 0 ? rate
+            : h.bandwidth + (rate - h.bandwidth) * BandwidthSmoothing;
+        h.windowBytes = 0;
+        h.windowStart = now;
+    }
+
+    if (!success && !delayed)
+        return; // errors say nothing about the congestion
+
+    // estimate the time to the first byte, if not measured,
+    //   by subtracting the time of the transfer itself,
+    //   which shares the bandwidth with the other downloads
+    double latency = firstByte;
+    if (latency <= 0)
+    {
+        latency = duration;
+        if (h.bandwidth > 0)
+            latency -= bytes * (double)concurrent / h.bandwidth;
+        latency = std::max(latency, 0.0);
+    }
+    if (h.minLatency == 0 || latency <= h.minLatency)
+    {
+        h.minLatency = std::max(latency, 1e-3);
+        h.minLatencyTime = now;
+    }
+    else if (seconds(now - h.minLatencyTime) > MinLatencyWindow)
+    {
+        // the current latency is likely inflated by the load itself
+        //   drain the queues to let the following replies remeasure it
+        h.minLatency = latency;
+        h.minLatencyTime = now;
+        h.limit = std::max(h.limit * 0.5, MinLimit);
+        h.lastDecrease = now;
+        return;
+    }
+
+    if (delayed || latency > h.minLatency * DelayFactor + DelayTolerance)
+    {
+        // decrease at most once per round trip
+        if (seconds(now - h.lastDecrease) > h.minLatency)
+        {
+            h.limit = std::max(h.limit * DecreaseFactor, MinLimit);
+            h.lastDecrease = now;
+        }
+        h.slowStart = false;
+    }
+    else
+    {
+        // double or increase by one per round of downloads
+        h.limit = std::min(h.limit + (h.slowStart ? 1 : 1 / h.limit),
+            std::max<double>(maxLimit, MinLimit));
+    }
+}
+
+uint32 DownloadThrottle::limit()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    uint32 sum = 0;
+    for (const auto &it : hosts)
+    {
+        if (it.second.inFlight > 0)
+            sum += (uint32)it.second.limit;
+    }
+    return sum;
+}
+
+uint64 DownloadThrottle::bandwidth()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    double sum = 0;
+    for (const auto &it : hosts)
+        sum += it.second.bandwidth;
+    return (uint64)sum;
+}
+
+} // namespace vts
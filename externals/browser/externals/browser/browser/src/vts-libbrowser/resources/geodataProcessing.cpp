@@ -2345,7 +2345,7 @@ void GeodataTile::decode()
     assert(!fetch);
 
     assert(state == Resource::State::downloaded);
-    map->statistics.resourcesDecoded++;
+    map->resources.counters.resourcesDecoded++;
 
     if (map->options.debugValidateGeodataStyles)
     {
@@ -2409,7 +2409,7 @@ void MapImpl::resourcesGeodataProcessorEntry()
         }
         catch (const std::exception &)
         {
-            statistics.resourcesFailed++;
+            resources.counters.resourcesFailed++;
             r->state = Resource::State::errorFatal;
         }
     }
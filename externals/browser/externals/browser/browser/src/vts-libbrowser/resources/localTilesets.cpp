@@ -0,0 +1,516 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "../include/vts-browser/buffer.hpp"
+#include "../localTilesets.hpp"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif // _WIN32
+
+#include <boost/crc.hpp>
+#include <boost/filesystem.hpp>
+#include <jsoncpp/json.hpp>
+#include <dbglog/dbglog.hpp>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace vts
+{
+
+namespace
+{
+
+const std::string Scheme = "tilar://";
+
+// layout of the tilar archives, see vts-libs/storage/tilar.cpp
+const uint32 HeaderSize = 28;
+const uint32 IndexHeaderSize = 24;
+const char HeaderMagic[5] = { 'T', 'I', 'L', 'A', 'R' };
+const char IndexMagic[4] = { 'T', 'I', 'D', 'X' };
+
+// the multifile table is at the end of the meshes and atlases
+//   see vts-libs/vts/multifile.cpp
+const uint32 MultifileTailSize = 6; // magic, version, count
+
+// maximum number of archives kept open
+const uint32 MaxOpenArchives = 128;
+
+enum class FileType
+{
+    Meta,
+    Mesh,
+    Atlas,
+};
+
+// path of the archive relative to the tileset, same as in the plain driver
+std::string archivePath(const std::string &extension,
+    uint32 lod, uint32 x, uint32 y)
+{
+    char filename[100];
+    std::snprintf(filename, sizeof(filename), "%u-%07u-%07u.%s",
+        lod, x, y, extension.c_str());
+    boost::crc_32_type crc;
+    crc.process_bytes(filename, std::strlen(filename));
+    char dir[10];
+    std::snprintf(dir, sizeof(dir), "%02x",
+        (unsigned)((crc.checksum() >> 24) & 0xff));
+    return std::string(dir) + "/" + filename;
+}
+
+} // namespace
+
+class LocalTilesets::Tileset
+{
+public:
+    std::string path;
+    uint32 binaryOrder = 0;
+    uint32 metaUnusedBits = 0;
+};
+
+class LocalTilesets::Archive : private Immovable
+{
+public:
+    struct Slot
+    {
+        uint32 start = 0;
+        uint32 size = 0;
+    };
+
+    Archive(const std::string &path, uint32 filesPerTile,
+        uint32 binaryOrder);
+    ~Archive();
+
+    Slot slot(uint32 col, uint32 row, uint32 type) const;
+    Buffer read(uint32 start, uint32 size) const;
+    Buffer readEntry(const Slot &slot, const char magic[2],
+        uint32 index) const;
+    void read(void *data, uint32 size, uint64 offset) const;
+
+    const std::string path;
+    std::vector<Slot> slots;
+    uint64 lastUse = 0;
+
+private:
+    void open(uint32 filesPerTile, uint32 binaryOrder);
+    void close();
+
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+#else
+    int file = -1;
+#endif // _WIN32
+    const uint32 edge;
+};
+
+LocalTilesets::Archive::Archive(const std::string &path,
+    uint32 filesPerTile, uint32 binaryOrder) :
+    path(path), edge(1u << binaryOrder)
+{
+    // the destructor is not called when the constructor throws
+    try
+    {
+        open(filesPerTile, binaryOrder);
+    }
+    catch (...)
+    {
+        close();
+        throw;
+    }
+}
+
+LocalTilesets::Archive::~Archive()
+{
+    close();
+}
+
+void LocalTilesets::Archive::open(uint32 filesPerTile, uint32 binaryOrder)
+{
+    uint64 fileSize = 0;
+#ifdef _WIN32
+    file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+        nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+        return; // no tiles in this archive
+    LARGE_INTEGER li;
+    if (GetFileSizeEx(file, &li))
+        fileSize = li.QuadPart;
+#else
+    file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        return; // no tiles in this archive
+    off_t end = ::lseek(file, 0, SEEK_END);
+    if (end > 0)
+        fileSize = end;
+#endif // _WIN32
+
+    const uint32 count = filesPerTile * edge * edge;
+    const uint64 indexSize = IndexHeaderSize + count * sizeof(Slot);
+    if (fileSize < HeaderSize + indexSize)
+    {
+        LOGTHROW(err2, std::runtime_error) << "Tilar archive <"
+            << path << "> is too short";
+    }
+
+    unsigned char header[HeaderSize];
+    read(header, HeaderSize, 0);
+    if (std::memcmp(header, HeaderMagic, sizeof(HeaderMagic)) != 0
+        || header[5] != 0 // version
+        || header[6] != binaryOrder || header[7] != filesPerTile)
+    {
+        LOGTHROW(err2, std::runtime_error) << "Tilar archive <"
+            << path << "> has invalid header";
+    }
+
+    // the latest index is at the end of the file
+    unsigned char indexHeader[IndexHeaderSize];
+    read(indexHeader, IndexHeaderSize, fileSize - indexSize);
+    if (std::memcmp(indexHeader, IndexMagic, sizeof(IndexMagic)) != 0)
+    {
+        LOGTHROW(err2, std::runtime_error) << "Tilar archive <"
+            << path << "> has invalid index";
+    }
+    slots.resize(count);
+    read(slots.data(), count * sizeof(Slot),
+        fileSize - indexSize + IndexHeaderSize);
+}
+
+void LocalTilesets::Archive::close()
+{
+#ifdef _WIN32
+    if (file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (file >= 0)
+        ::close(file);
+    file = -1;
+#endif // _WIN32
+}
+
+LocalTilesets::Archive::Slot LocalTilesets::Archive::slot(
+    uint32 col, uint32 row, uint32 type) const
+{
+    uint64 i = col + (uint64)edge * (row + (uint64)edge * type);
+    if (i < slots.size())
+        return slots[i];
+    return Slot();
+}
+
+Buffer LocalTilesets::Archive::read(uint32 start, uint32 size) const
+{
+    Buffer b(size);
+    read(b.data(), size, start);
+    return b;
+}
+
+Buffer LocalTilesets::Archive::readEntry(const Slot &slot,
+    const char magic[2], uint32 index) const
+{
+    // read just the table and the one entry
+    unsigned char tail[MultifileTailSize];
+    if (slot.size < MultifileTailSize)
+    {
+        LOGTHROW(err2, std::runtime_error) << "File in tilar archive <"
+            << path << "> is too short";
+    }
+    read(tail, MultifileTailSize, slot.start + slot.size - MultifileTailSize);
+    uint16 count = 0;
+    std::memcpy(&count, tail + 4, sizeof(count));
+    if (std::memcmp(tail, magic, 2) != 0 || index >= count
+        || slot.size < MultifileTailSize + count * 8u)
+    {
+        LOGTHROW(err2, std::runtime_error) << "File in tilar archive <"
+            << path << "> has invalid table";
+    }
+    const uint32 tableStart = slot.size - MultifileTailSize - count * 8;
+    uint32 entry[2]; // start, size
+    read(entry, sizeof(entry), slot.start + tableStart + index * 8);
+    if (entry[0] > tableStart || entry[1] > tableStart - entry[0])
+    {
+        LOGTHROW(err2, std::runtime_error) << "File in tilar archive <"
+            << path << "> has invalid table";
+    }
+    return read(slot.start + entry[0], entry[1]);
+}
+
+void LocalTilesets::Archive::read(void *data, uint32 size,
+    uint64 offset) const
+{
+    // positional reads do not share the file position
+    //   and may run in multiple threads concurrently
+    char *d = (char *)data;
+    while (size > 0)
+    {
+#ifdef _WIN32
+        OVERLAPPED o = {};
+        o.Offset = (DWORD)offset;
+        o.OffsetHigh = (DWORD)(offset >> 32);
+        DWORD r = 0;
+        if (!ReadFile(file, d, size, &r, &o))
+            r = 0;
+#else
+        ssize_t r = ::pread(file, d, size, offset);
+        if (r < 0 && errno == EINTR)
+            continue;
+#endif // _WIN32
+        if (r <= 0)
+        {
+            LOGTHROW(err2, std::runtime_error) << "Failed to read from "
+                "tilar archive <" << path << ">";
+        }
+        d += r;
+        size -= r;
+        offset += r;
+    }
+}
+
+void LocalTilesets::initialize(const std::string &path)
+{
+    if (path.empty())
+        return;
+    LOG(info3) << "Using local tilesets from <" << path << ">";
+    root = path;
+}
+
+void LocalTilesets::load(const std::vector<std::string> &tilesetIds)
+{
+    if (root.empty())
+        return;
+    for (const std::string &id : tilesetIds)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            if (tilesets.count(id))
+                continue;
+        }
+        // the config is parsed outside the lock
+        std::shared_ptr<Tileset> ts = loadTileset(id);
+        std::lock_guard<std::mutex> lock(mut);
+        tilesets.emplace(id, ts);
+    }
+}
+
+bool LocalTilesets::resolve(const std::string &tilesetId,
+    UrlTemplate &meta, UrlTemplate &mesh, UrlTemplate &texture)
+{
+    if (root.empty())
+        return false;
+
+    // the tilesets are usually loaded with the mapconfig
+    //   in a decoder thread already
+    load({ tilesetId });
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        auto it = tilesets.find(tilesetId);
+        if (it == tilesets.end() || !it->second)
+            return false;
+    }
+
+    const std::string prefix = Scheme + tilesetId;
+    meta.parse(prefix + "/meta/{lod}-{x}-{y}");
+    mesh.parse(prefix + "/mesh/{lod}-{x}-{y}");
+    texture.parse(prefix + "/atlas/{lod}-{x}-{y}-{sub}");
+    return true;
+}
+
+std::shared_ptr<LocalTilesets::Tileset> LocalTilesets::loadTileset(
+    const std::string &tilesetId)
+{
+    std::shared_ptr<Tileset> ts;
+    const std::string path = root + "/" + tilesetId;
+    const std::string config = path + "/tileset.conf";
+    try
+    {
+        if (boost::filesystem::exists(config))
+        {
+            Json::Value v;
+            {
+                Buffer b = readLocalFileBuffer(config);
+                detail::BufferStream w(b);
+                w >> v;
+            }
+            const Json::Value &driver = v["driver"];
+            if (driver.get("type", "plain").asString() == "plain")
+            {
+                ts = std::make_shared<Tileset>();
+                ts->path = path;
+                ts->binaryOrder = driver["binaryOrder"].asUInt();
+                ts->metaUnusedBits
+                    = driver.get("metaUnusedBits", 0).asUInt();
+                LOG(info3) << "Surface <" << tilesetId
+                    << "> is available in a local tileset";
+            }
+            else
+            {
+                LOG(warn3) << "Local tileset <" << tilesetId
+                    << "> does not use the plain driver";
+            }
+        }
+    }
+    catch (const std::exception &e)
+    {
+        LOG(warn3) << "Failed to open local tileset <"
+            << tilesetId << ">, exception <" << e.what() << ">";
+        ts.reset();
+    }
+    return ts;
+}
+
+Buffer LocalTilesets::read(const std::string &name)
+{
+    // tilar://<tileset>/<type>/<lod>-<x>-<y>[-<sub>]
+    const auto a = name.rfind('/');
+    const auto b = a == std::string::npos || a == 0
+        ? std::string::npos : name.rfind('/', a - 1);
+    if (!owns(name) || b == std::string::npos || b <= Scheme.size())
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Invalid local resource name <" << name << ">";
+    }
+    const std::string id = name.substr(Scheme.size(), b - Scheme.size());
+    const std::string type = name.substr(b + 1, a - b - 1);
+    uint32 lod = 0, x = 0, y = 0, sub = 0;
+    const int vars = std::sscanf(name.c_str() + a + 1, "%u-%u-%u-%u",
+        &lod, &x, &y, &sub);
+
+    FileType fileType;
+    if (type == "meta" && vars == 3)
+        fileType = FileType::Meta;
+    else if (type == "mesh" && vars == 3)
+        fileType = FileType::Mesh;
+    else if (type == "atlas" && vars == 4)
+        fileType = FileType::Atlas;
+    else
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Invalid local resource name <" << name << ">";
+        throw;
+    }
+
+    std::shared_ptr<Tileset> ts;
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        auto it = tilesets.find(id);
+        if (it != tilesets.end())
+            ts = it->second;
+    }
+    if (!ts)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Unknown local tileset in <" << name << ">";
+    }
+
+    if (fileType == FileType::Meta)
+    {
+        // shrink the metatiles space
+        x >>= ts->metaUnusedBits;
+        y >>= ts->metaUnusedBits;
+    }
+    const uint32 bo = ts->binaryOrder;
+    const uint32 mask = (1u << bo) - 1;
+    const bool meta = fileType == FileType::Meta;
+    std::shared_ptr<Archive> ar = archive(ts->path + "/"
+        + archivePath(meta ? "metatiles" : "tiles", lod, x >> bo, y >> bo),
+        meta ? 1 : 2, bo);
+    const Archive::Slot s = ar->slot(x & mask, y & mask,
+        fileType == FileType::Atlas ? 1 : 0);
+    if (s.start == 0)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Resource <" << name << "> is missing in the local tileset";
+    }
+
+    switch (fileType)
+    {
+    case FileType::Meta:
+        return ar->read(s.start, s.size);
+    case FileType::Mesh:
+        // the mesh proper is the first entry
+        return ar->readEntry(s, "ME", 0);
+    case FileType::Atlas:
+        // one image for each submesh
+        return ar->readEntry(s, "AT", sub);
+    }
+    throw;
+}
+
+bool LocalTilesets::owns(const std::string &name)
+{
+    return name.compare(0, Scheme.size(), Scheme) == 0;
+}
+
+std::shared_ptr<LocalTilesets::Archive> LocalTilesets::archive(
+    const std::string &path, uint32 filesPerTile, uint32 binaryOrder)
+{
+    {
+        std::lock_guard<std::mutex> lock(mut);
+        auto it = archives.find(path);
+        if (it != archives.end())
+        {
+            it->second->lastUse = archivesUseIndex++;
+            return it->second;
+        }
+    }
+
+    // opening the archive reads its index
+    //   and must not block the other threads
+    LOG(info1) << "Opening tilar archive <" << path << ">";
+    auto ar = std::make_shared<Archive>(path, filesPerTile, binaryOrder);
+
+    std::lock_guard<std::mutex> lock(mut);
+    auto it = archives.find(path);
+    if (it == archives.end())
+    {
+        if (archives.size() >= MaxOpenArchives)
+        {
+            // close the least recently used archive
+            //   it stays open while it is being read
+            auto lru = archives.begin();
+            for (auto jt = archives.begin(); jt != archives.end(); jt++)
+                if (jt->second->lastUse < lru->second->lastUse)
+                    lru = jt;
+            archives.erase(lru);
+        }
+        it = archives.emplace(path, std::move(ar)).first;
+    }
+    // else another thread has opened the same archive meanwhile
+    //   and ours is closed
+    it->second->lastUse = archivesUseIndex++;
+    return it->second;
+}
+
+} // namespace vts
@@ -35,6 +35,8 @@
 
 #include <thread>
 #include <chrono>
+#include <cmath>
+#include <limits>
 
 namespace vts
 {
@@ -62,6 +64,9 @@ void MapImpl::resourceSaveCorruptedFile(const std::shared_ptr<Resource> &r)
 namespace
 {
 
+// the disk cache keeps only few read ahead entries anyway
+const uint32 MaxQueuedReadAheads = 128;
+
 typedef std::pair<float, std::shared_ptr<Resource>> ResourceWithPriority;
 
 std::vector<ResourceWithPriority> filterSortResources(
@@ -88,6 +93,20 @@ std::vector<ResourceWithPriority> filterSortResources(
     return res;
 }
 
+void addDownloadLatency(MapImpl::Resources &resources,
+    FetchTask::ResourceType type, MapStatistics::DownloadPhase phase,
+    double seconds)
+{
+    if (!(seconds > 0))
+        return; // the phase did not happen
+    double ms = seconds * 1000;
+    uint32 bucket = 0;
+    if (ms >= 1)
+        bucket = (uint32)(std::log2(ms) * 2) + 1;
+    bucket = std::min(bucket, MapStatistics::DownloadLatencyBuckets - 1);
+    resources.downloadLatency[(uint32)type][(uint32)phase][bucket]++;
+}
+
 } // namespace
 
 UploadData::UploadData()
@@ -110,14 +129,84 @@ void UploadData::process()
         r->map->resourceUploadProcess(r);
 }
 
+bool threadQueuePriority(const std::weak_ptr<Resource> &resource,
+    float &priority)
+{
+    std::shared_ptr<Resource> r = resource.lock();
+    if (!r)
+        return false;
+    priority = r->priority;
+    if (std::isnan(priority))
+        priority = 0;
+    return true;
+}
+
+DownloadRequest::DownloadRequest()
+{}
+
+DownloadRequest::DownloadRequest(const std::shared_ptr<Resource> &resource)
+    : resource(resource)
+{}
+
+bool threadQueuePriority(const DownloadRequest &data, float &priority)
+{
+    std::shared_ptr<Resource> r = data.resource.lock();
+    if (!r || r->state != Resource::State::startDownload)
+        return false;
+    priority = r->priority;
+    if (std::isnan(priority))
+        priority = 0;
+    priority = std::max(priority, r->fetchPriority);
+    return true;
+}
+
+CacheReadRequest::CacheReadRequest()
+{}
+
+CacheReadRequest::CacheReadRequest(const std::shared_ptr<Resource> &resource)
+    : resource(resource)
+{}
+
+CacheReadRequest::CacheReadRequest(const std::string &readAhead)
+    : readAhead(readAhead)
+{}
+
+bool threadQueuePriority(const CacheReadRequest &data, float &priority)
+{
+    if (!data.readAhead.empty())
+    {
+        priority = -std::numeric_limits<float>::max();
+        return true;
+    }
+    // expired resources are not dropped
+    //   the workers must count them as finished
+    std::shared_ptr<Resource> r = data.resource.lock();
+    priority = r ? r->priority : std::numeric_limits<float>::infinity();
+    if (std::isnan(priority))
+        priority = 0;
+    return true;
+}
+
+bool threadQueuePriority(const UploadData &data, float &priority)
+{
+    if (data.destroyData)
+    {
+        // releasing memory takes precedence
+        priority = std::numeric_limits<float>::infinity();
+        return true;
+    }
+    return threadQueuePriority(data.uploadData, priority);
+}
+
 ////////////////////////////
 // A FETCH THREAD
 ////////////////////////////
 
 CacheData::CacheData(FetchTaskImpl *task, bool availFailed) :
     //availTest(task->availTest),
-    buffer(task->reply.content.copy()),
-    name(task->name), expires(task->reply.expires),
+    buffer(task->reply.content.share()),
+    name(task->name), etag(task->reply.etag),
+    expires(task->reply.expires), lastModified(task->reply.lastModified),
     availFailed(availFailed)
 {}
 
@@ -129,12 +218,107 @@ void FetchTaskImpl::fetchDone()
         << reply.contentType << ">, size: " << reply.content.size()
         << ", expires: " << reply.expires;
     assert(map);
-    map->resources.downloads--;
+    const double duration = std::chrono::duration<double>(
+        std::chrono::steady_clock::now() - fetchStart).count();
+    if (!throttleHost.empty())
+    {
+        bool success = (reply.code >= 200 && reply.code < 300)
+            || reply.code == 304;
+        bool delayed = reply.code == FetchTask::ExtraCodes::Timeout
+            || reply.code == 429 || reply.code == 503;
+        map->resources.downloadThrottle.release(throttleHost,
+            reply.timings.firstByte, duration,
+            reply.transferredSize ? reply.transferredSize
+            : reply.content.size(), success, delayed,
+            map->options.maxAdaptiveConcurrentDownloads);
+        throttleHost.clear();
+    }
+
+    // latency statistics
+    //   this runs in the fetch threads
+    if (reply.code != FetchTask::ExtraCodes::Cancelled)
+    {
+        typedef MapStatistics::DownloadPhase Phase;
+        const Reply::Timings &t = reply.timings;
+        MapImpl::Resources &s = map->resources;
+        const ResourceType type = query.resourceType;
+        addDownloadLatency(s, type, Phase::Queue,
+            std::chrono::duration<double>(
+            fetchStart - queueStart).count());
+        addDownloadLatency(s, type, Phase::NameLookup, t.nameLookup);
+        if (t.connect > 0)
+        {
+            addDownloadLatency(s, type, Phase::Connect,
+                t.connect - t.nameLookup);
+        }
+        if (t.tls > 0)
+            addDownloadLatency(s, type, Phase::Tls, t.tls - t.connect);
+        addDownloadLatency(s, type, Phase::FirstByte, t.firstByte);
+        if (t.firstByte > 0)
+        {
+            addDownloadLatency(s, type, Phase::Transfer,
+                t.total - t.firstByte);
+        }
+        addDownloadLatency(s, type, Phase::Total, duration);
+    }
+
+    std::vector<DownloadRequest> blocked;
+    {
+        std::lock_guard<std::mutex> lock(map->resources.downloadsMutex);
+        map->resources.downloads--;
+        blocked.swap(map->resources.downloadsBlocked);
+    }
     map->resources.downloadsCondition.notify_one();
+    // the blocked resources compete for the freed slot again
+    for (DownloadRequest &d : blocked)
+        map->resources.queFetching.push(std::move(d));
     Resource::State state = Resource::State::downloading;
 
+    // cancelled downloads start over when the resource is needed again
+    if (reply.code == FetchTask::ExtraCodes::Cancelled)
+    {
+        LOG(debug) << "Download of <" << name << "> was cancelled";
+        map->resources.counters.resourcesCancelled++;
+        reply = Reply();
+        state = Resource::State::initializing;
+    }
+
+    // transfer statistics
+    if (reply.code >= 200 && reply.code < 300)
+    {
+        uint32 t = (uint32)query.resourceType;
+        assert(t < FetchTask::ResourceTypesCount);
+        uint32 size = reply.content.size();
+        map->resources.counters.downloadedBytesTransferred[t]
+            += reply.transferredSize ? reply.transferredSize : size;
+        map->resources.counters.downloadedBytesDecoded[t] += size;
+    }
+
+    // the expired content from the disk cache is still valid
+    bool revalidated = false;
+    if (revalidation.active)
+    {
+        if (reply.code == 304)
+        {
+            LOG(debug) << "Resource <" << name << "> was not modified";
+            map->resources.counters.resourcesRevalidated++;
+            reply.content = std::move(revalidation.content);
+            reply.etag = revalidation.etag;
+            reply.lastModified = revalidation.lastModified;
+            reply.expires = -2; // the reply carries no new expiration
+            reply.code = 200;
+            if (revalidation.availFailed)
+                state = Resource::State::availFail;
+            revalidated = true;
+        }
+        query.headers.erase("If-None-Match");
+        query.headers.erase("If-Modified-Since");
+        revalidation = Revalidation();
+    }
+
     // handle error or invalid codes
-    if (reply.code >= 400 || reply.code < 200)
+    if (state == Resource::State::downloading
+        && (reply.code >= 400 || reply.code < 200))
     {
         if (reply.code == FetchTask::ExtraCodes::ProhibitedContent)
             state = Resource::State::errorFatal;
@@ -152,8 +336,23 @@ void FetchTaskImpl::fetchDone()
     if (!Resource::allowDiskCache(query.resourceType))
         reply.expires = -2;
 
+    // remember resources that are missing on the server
+    //   so that they are not requested again, even after restart
+    if ((reply.code == 404 || reply.code == 410
+        || state == Resource::State::errorFatal)
+        && Resource::allowDiskCache(query.resourceType)
+        && map->resources.queCacheWrite.estimateSize()
+        < map->options.maxCacheWriteQueueLength)
+    {
+        CacheData cd;
+        cd.name = name;
+        cd.expires = reply.expires;
+        cd.notFound = true;
+        map->resources.queCacheWrite.push(std::move(cd));
+    }
+
     // availability tests
-    if (state == Resource::State::downloading
+    if (state == Resource::State::downloading && !revalidated
         && !performAvailTest())
     {
         LOG(info1) << "Resource <" << name
@@ -189,7 +388,7 @@ void FetchTaskImpl::fetchDone()
         && map->resources.queCacheWrite.estimateSize()
         < map->options.maxCacheWriteQueueLength)
     {
-        // this makes copy of the content buffer
+        // the content buffer is shared with the cache writer
         map->resources.queCacheWrite.push(CacheData(this,
             state == Resource::State::availFail));
     }
@@ -222,16 +421,33 @@ void FetchTaskImpl::fetchDone()
 }
 
 ////////////////////////////
-// DECODE THREAD
+// DECODE THREADS
 ////////////////////////////
 
+namespace
+{
+
+thread_local uint32 decoderThreadIndexValue = (uint32)-1;
+
+} // namespace
+
+uint32 decoderThreadIndex()
+{
+    if (decoderThreadIndexValue == (uint32)-1)
+    {
+        LOGTHROW(fatal, std::logic_error)
+            << "Decoder thread index requested outside decoder threads";
+    }
+    return decoderThreadIndexValue;
+}
+
 void MapImpl::resourceDecodeProcess(const std::shared_ptr<Resource> &r)
 {
     OPTICK_EVENT();
     OPTICK_TAG("name", r->name.c_str());
 
     assert(r->state == Resource::State::downloaded);
-    statistics.resourcesDecoded++;
+    resources.counters.resourcesDecoded++;
     r->info.gpuMemoryCost = r->info.ramMemoryCost = 0;
     try
     {
@@ -249,16 +465,17 @@ void MapImpl::resourceDecodeProcess(const std::shared_ptr<Resource> &r)
         LOG(err3) << "Failed decoding resource <" << r->name
             << ">, exception <" << e.what() << ">";
         resourceSaveCorruptedFile(r);
-        statistics.resourcesFailed++;
+        resources.counters.resourcesFailed++;
         r->state = Resource::State::errorFatal;
     }
     r->fetch.reset();
 }
 
-void MapImpl::resourcesDecodeProcessorEntry()
+void MapImpl::resourcesDecodeProcessorEntry(uint32 index)
 {
     OPTICK_THREAD("decode");
-    setLogThreadName("decode");
+    setLogThreadName(std::string() + "decode " + std::to_string(index));
+    decoderThreadIndexValue = index;
     while (!resources.queDecode.stopped())
     {
         std::weak_ptr<Resource> w;
@@ -291,7 +508,7 @@ void MapImpl::resourceUploadProcess(const std::shared_ptr<Resource> &r)
         LOG(err3) << "Failed uploading resource <" << r->name
             << ">, exception <" << e.what() << ">";
         resourceSaveCorruptedFile(r);
-        statistics.resourcesFailed++;
+        resources.counters.resourcesFailed++;
         r->state = Resource::State::errorFatal;
     }
     r->decodeData.reset();
@@ -336,6 +553,7 @@ void MapImpl::cacheWriteEntry()
 {
     OPTICK_THREAD("cache writer");
     setLogThreadName("cache writer");
+    cacheMaintenance();
     while (!resources.queCacheWrite.stopped())
     {
         CacheData cwd;
@@ -358,26 +576,104 @@ void MapImpl::cacheReadEntry()
         auto res1 = resources.queCacheRead.readAllWait();
         OPTICK_EVENT("update");
         auto res2 = filterSortResources(res1, Resource::State::checkCache);
-        for (const auto &pr : res2)
+
+        if (resources.thrCacheReadWorkers.empty())
         {
-            const std::shared_ptr<Resource> &r = pr.second;
-            try
+            for (const auto &pr : res2)
             {
-                cacheReadProcess(r);
+                cacheReadProcessSafe(pr.second);
+                if (resources.queCacheRead.estimateSize() > 0)
+                    break; // refresh the priorities
             }
-            catch (const std::exception &e)
+            // read ahead while there is no new batch
+            CacheReadRequest d;
+            while (resources.queCacheRead.estimateSize() == 0
+                && resources.queCacheReadWorkers.tryPop(d))
             {
-                statistics.resourcesFailed++;
-                r->state = Resource::State::errorFatal;
-                LOG(err3) << "Failed preparing resource <" << r->name
-                    << ">, exception <" << e.what() << ">";
+                resources.cacheReadAheadsQueued--;
+                cacheReadAhead(d.readAhead);
             }
+            continue;
+        }
+
+        // distribute the batch among the workers, highest priority first
+        resources.cacheReadsInFlight = res2.size();
+        for (const auto &pr : res2)
+            resources.queCacheReadWorkers.push(CacheReadRequest(pr.second));
+
+        // wait for the whole batch to finish
+        //   so that no resource is read twice by two batches
+        // the render thread notifies when it publishes a new batch
+        std::unique_lock<std::mutex> lock(resources.cacheReadsMutex);
+        while (resources.cacheReadsInFlight > 0
+            && !resources.queCacheRead.stopped())
+        {
+            resources.cacheReadsCondition.wait(lock);
             if (resources.queCacheRead.estimateSize() > 0)
-                break; // refresh the priorities
+            {
+                // refresh the priorities
+                //   the remaining resources will come again in the next batch
+                //   the read ahead requests are kept
+                std::vector<CacheReadRequest> keep;
+                CacheReadRequest d;
+                while (resources.queCacheReadWorkers.tryPop(d))
+                {
+                    if (d.readAhead.empty())
+                        resources.cacheReadsInFlight--;
+                    else
+                        keep.push_back(std::move(d));
+                }
+                for (CacheReadRequest &k : keep)
+                    resources.queCacheReadWorkers.push(std::move(k));
+            }
         }
     }
 }
 
+void MapImpl::cacheReadWorkerEntry(uint32 index)
+{
+    OPTICK_THREAD("cache read");
+    setLogThreadName(std::string() + "cache read " + std::to_string(index));
+    while (!resources.queCacheReadWorkers.stopped())
+    {
+        CacheReadRequest d;
+        if (!resources.queCacheReadWorkers.waitPop(d))
+            continue;
+        if (!d.readAhead.empty())
+        {
+            // the workers are idle otherwise
+            resources.cacheReadAheadsQueued--;
+            cacheReadAhead(d.readAhead);
+            continue;
+        }
+        {
+            std::shared_ptr<Resource> r = d.resource.lock();
+            if (r && r->state == Resource::State::checkCache)
+                cacheReadProcessSafe(r);
+        }
+        {
+            std::lock_guard<std::mutex> lock(resources.cacheReadsMutex);
+            resources.cacheReadsInFlight--;
+        }
+        resources.cacheReadsCondition.notify_all();
+    }
+}
+
+void MapImpl::cacheReadProcessSafe(const std::shared_ptr<Resource> &r)
+{
+    try
+    {
+        cacheReadProcess(r);
+    }
+    catch (const std::exception &e)
+    {
+        resources.counters.resourcesFailed++;
+        r->state = Resource::State::errorFatal;
+        LOG(err3) << "Failed preparing resource <" << r->name
+            << ">, exception <" << e.what() << ">";
+    }
+}
+
 namespace
 {
 
@@ -395,10 +691,31 @@ void MapImpl::cacheReadProcess(const std::shared_ptr<Resource> &r)
     if (!r->fetch)
         r->fetch = std::make_shared<FetchTaskImpl>(r);
     r->info.gpuMemoryCost = r->info.ramMemoryCost = 0;
-    CacheData cd;
-    if (r->allowDiskCache() && (cd = cacheRead(
-        r->name)).name == r->name)
+    // local tilesets bypass the disk cache
+    const bool local = LocalTilesets::owns(r->name);
+    if (!local && r->allowDiskCache() && cacheReadNegative(r->name))
+    {
+        LOG(info1) << "Resource <" << r->name
+            << "> is known to be missing, skipping download";
+        r->state = Resource::State::errorFatal;
+        return;
+    }
+    CacheData cd = local ? CacheData() : cacheRead(r->name);
+    if (cd.name == r->name && (cd.stale || !r->allowDiskCache()))
+    {
+        // expired content is revalidated by the server
+        //   and used again if it was not modified
+        if (cd.stale)
+        {
+            r->fetch->revalidate(std::move(cd.buffer), cd.etag,
+                cd.lastModified, cd.availFailed);
+        }
+        cd = CacheData();
+    }
+    bool diskLoaded = false;
+    if (cd.name == r->name)
     {
+        diskLoaded = true;
         r->fetch->reply.expires = cd.expires;
         r->fetch->reply.content = std::move(cd.buffer);
         r->fetch->reply.code = 200;
@@ -406,7 +723,14 @@ void MapImpl::cacheReadProcess(const std::shared_ptr<Resource> &r)
             r->state = Resource::State::availFail;
         else
             r->state = Resource::State::downloaded;
-        statistics.resourcesDiskLoaded++;
+        resources.counters.resourcesDiskLoaded++;
+    }
+    else if (local)
+    {
+        r->fetch->reply.content = resources.localTilesets.read(r->name);
+        r->fetch->reply.code = 200;
+        r->state = Resource::State::downloaded;
+        resources.counters.resourcesLocalLoaded++;
     }
     else if (startsWith(r->name, "data:"))
     {
@@ -440,6 +764,23 @@ void MapImpl::cacheReadProcess(const std::shared_ptr<Resource> &r)
 
     if (r->state == Resource::State::downloaded)
         resources.queDecode.push(r);
+    else if (r->state == Resource::State::startDownload)
+    {
+        r->fetch->queueStart = std::chrono::steady_clock::now();
+        resources.queFetching.push(DownloadRequest(r));
+    }
+
+    // the read ahead is queued behind all the regular reads
+    if (diskLoaded && createOptions.cacheReadAhead)
+    {
+        for (const std::string &n : r->readAhead)
+        {
+            if (resources.cacheReadAheadsQueued >= MaxQueuedReadAheads)
+                break;
+            resources.cacheReadAheadsQueued++;
+            resources.queCacheReadWorkers.push(CacheReadRequest(n));
+        }
+    }
 }
 
 ////////////////////////////
@@ -451,32 +792,62 @@ void MapImpl::resourcesDownloadsEntry()
     OPTICK_THREAD("fetcher");
     setLogThreadName("fetcher");
     resources.fetcher->initialize();
-    std::mutex dummyMutex;
     while (!resources.queFetching.stopped())
     {
-        auto res1 = resources.queFetching.readAllWait();
-        OPTICK_EVENT("update");
-        resources.fetcher->update();
-        auto res2 = filterSortResources(res1, Resource::State::startDownload);
-        for (const auto &pr : res2)
+        const bool adaptive = options.adaptiveConcurrentDownloads;
+        const uint32 limit = adaptive
+            ? options.maxAdaptiveConcurrentDownloads
+            : options.maxConcurrentDownloads;
+
+        // wait for a free slot first
+        //   the resource is chosen afterwards
+        //   so that it is the most important one at that time
         {
-            while (resources.downloads >= options.maxConcurrentDownloads)
-            {
-                std::unique_lock<std::mutex> lock(dummyMutex);
+            std::unique_lock<std::mutex> lock(resources.downloadsMutex);
+            while (resources.downloads >= limit
+                && !resources.queFetching.stopped())
                 resources.downloadsCondition.wait(lock);
-            }
-            const std::shared_ptr<Resource> &r = pr.second;
-            r->state = Resource::State::downloading;
-            resources.downloads++;
-            LOG(debug) << "Initializing fetch of <" << r->name << ">";
-            r->fetch->query.headers["X-Vts-Client-Id"]
-                = createOptions.clientId;
-            if (resources.auth)
-                resources.auth->authorize(r);
-            resources.fetcher->fetch(r->fetch);
-            statistics.resourcesDownloaded++;
-            if (resources.queFetching.estimateSize() > 0)
-                break; // refresh the priorities
+        }
+
+        DownloadRequest d;
+        if (!resources.queFetching.waitPop(d))
+            continue;
+        OPTICK_EVENT("fetch");
+        resources.fetcher->update();
+        const std::shared_ptr<Resource> r = d.resource.lock();
+        if (!r || r->state != Resource::State::startDownload)
+            continue;
+
+        // resources of hosts that reached their limit
+        //   wait for a download to finish
+        std::string host = DownloadThrottle::host(r->fetch->query.url);
+        if (!resources.downloadThrottle.acquire(host,
+            options.maxConcurrentDownloads, adaptive))
+        {
+            std::lock_guard<std::mutex> lock(resources.downloadsMutex);
+            resources.downloadsBlocked.push_back(std::move(d));
+            continue;
+        }
+
+        float priority = 0;
+        threadQueuePriority(d, priority);
+        r->fetch->query.priority = priority;
+        r->fetch->throttleHost = std::move(host);
+        r->fetch->fetchStart = std::chrono::steady_clock::now();
+        r->fetch->cancelled = false;
+        r->state = Resource::State::downloading;
+        resources.downloads++;
+        LOG(debug) << "Initializing fetch of <" << r->name << ">";
+        r->fetch->query.headers["X-Vts-Client-Id"]
+            = createOptions.clientId;
+        if (resources.auth)
+            resources.auth->authorize(r);
+        resources.fetcher->fetch(r->fetch);
+        statistics.resourcesDownloaded++;
+        {
+            std::lock_guard<std::mutex> lock(
+                resources.downloadsInFlightMutex);
+            resources.downloadsInFlight.push_back(r);
         }
     }
     resources.fetcher->finalize();
@@ -487,10 +858,86 @@ void MapImpl::resourcesDownloadsEntry()
 // MAIN THREAD
 ////////////////////////////
 
+namespace
+{
+
+// states in which the resource is removed as soon as it is not used
+bool unconditionalRemoveState(Resource::State state)
+{
+    switch (state)
+    {
+    case Resource::State::initializing:
+    case Resource::State::startDownload:
+    case Resource::State::errorFatal:
+    case Resource::State::errorRetry:
+    case Resource::State::availFail:
+        return true;
+    default:
+        return false;
+    }
+}
+
+// states that require further processing in the render thread
+//   (including the removal)
+bool pendingState(Resource::State state)
+{
+    return state == Resource::State::checkCache
+        || unconditionalRemoveState(state);
+}
+
+} // namespace
+
+void MapImpl::resourceTrack(const std::shared_ptr<Resource> &r)
+{
+    assert(!r->tracked);
+    r->tracked = true;
+    r->lruPosition = resources.lru.insert(resources.lru.end(), r.get());
+    Resource::State state = r->state;
+    resources.statesCounts[(uint32)state]++;
+    if (pendingState(state) && !r->pending.exchange(true))
+        resources.pending.push_back(r);
+}
+
+void MapImpl::resourceStateChanged(Resource *r,
+    Resource::State old, Resource::State state)
+{
+    // this may be called from any thread
+    resources.statesCounts[(uint32)old]--;
+    resources.statesCounts[(uint32)state]++;
+
+    // the memory costs are updated before the state changes
+    uint32 ram = r->info.ramMemoryCost;
+    uint32 gpu = r->info.gpuMemoryCost;
+    resources.ramMemoryUse += (sint64)ram - (sint64)r->ramMemoryAccounted;
+    resources.gpuMemoryUse += (sint64)gpu - (sint64)r->gpuMemoryAccounted;
+    r->ramMemoryAccounted = ram;
+    r->gpuMemoryAccounted = gpu;
+    if (!pendingState(state) || r->pending.exchange(true))
+        return;
+    std::weak_ptr<Resource> w = r->shared_from_this();
+    std::lock_guard<std::mutex> lock(resources.stateChangesMutex);
+    resources.stateChanges.push_back(std::move(w));
+}
+
+void MapImpl::resourcesCollectPending()
+{
+    OPTICK_EVENT();
+    std::vector<std::weak_ptr<Resource>> changes;
+    {
+        std::lock_guard<std::mutex> lock(resources.stateChangesMutex);
+        changes.swap(resources.stateChanges);
+    }
+    resources.pending.insert(resources.pending.end(),
+        std::make_move_iterator(changes.begin()),
+        std::make_move_iterator(changes.end()));
+}
+
 bool MapImpl::resourcesTryRemove(std::shared_ptr<Resource> &r)
 {
     std::string name = r->name;
     assert(resources.resources.count(name) == 1);
+    assert(r->tracked);
+    auto lruPosition = r->lruPosition;
     {
         // release the pointer if we are the last one holding it
         std::weak_ptr<Resource> w = r;
@@ -513,6 +960,7 @@ bool MapImpl::resourcesTryRemove(std::shared_ptr<Resource> &r)
     {
         LOG(info1) << "Released resource <" << name << ">";
         resources.resources.erase(name);
+        resources.lru.erase(lruPosition);
         statistics.resourcesReleased++;
         return true;
     }
@@ -522,76 +970,94 @@ bool MapImpl::resourcesTryRemove(std::shared_ptr<Resource> &r)
 void MapImpl::resourcesRemoveOld()
 {
     OPTICK_EVENT();
-    struct Res
-    {
-        const std::string *n; // name
-        uint32 m; // memory used
-        uint32 a; // lastAccessTick
-        Res(const std::string *n, uint32 m, uint32 a) : n(n), m(m), a(a)
-        {}
-    };
-    // successfully loaded resources are removed
-    //   only when we are tight on memory
-    std::vector<Res> resourcesToRemove;
-    resourcesToRemove.reserve(resources.resources.size() / 4);
-    // resources that errored are removed immediately
-    std::vector<Res> unconditionalToRemove;
-    unconditionalToRemove.reserve(resources.resources.size() / 4);
-    uint64 memRamUse = 0;
-    uint64 memGpuUse = 0;
-    // find resource candidates for removal
-    for (const auto &it : resources.resources)
-    {
-        memRamUse += it.second->info.ramMemoryCost;
-        memGpuUse += it.second->info.gpuMemoryCost;
-        // skip recently used resources
-        if (it.second->lastAccessTick + 5 < renderTickIndex)
+    const uint64 targetTotal = (uint64)options.targetResourcesMemoryKB * 1024;
+    const uint64 targetGpu = (uint64)options.targetGpuMemoryKB * 1024;
+    const uint64 targetRam = (uint64)options.targetRamMemoryKB * 1024;
+
+    // resources that errored or never started are removed
+    //   as soon as they are not used
+    // they are all listed in the pending resources,
+    //   so the lru list does not have to be walked for them
+    {
+        std::vector<std::string> unused;
+        for (const auto &w : resources.pending)
         {
-            Res r(&it.second->name,
-                it.second->info.ramMemoryCost + it.second->info.gpuMemoryCost,
-                it.second->lastAccessTick);
-            switch ((vts::Resource::State)it.second->state)
-            {
-            case Resource::State::initializing:
-            case Resource::State::startDownload:
-            case Resource::State::errorFatal:
-            case Resource::State::errorRetry:
-            case Resource::State::availFail:
-                unconditionalToRemove.push_back(std::move(r));
-                break;
-            default:
-                resourcesToRemove.push_back(std::move(r));
-                break;
-            }
+            const std::shared_ptr<Resource> r = w.lock();
+            if (r && r->tracked && r->lastAccessTick + 5 < renderTickIndex
+                && unconditionalRemoveState(r->state))
+                unused.push_back(r->name);
+        }
+        for (const std::string &name : unused)
+        {
+            auto it = resources.resources.find(name);
+            if (it != resources.resources.end())
+                resourcesTryRemove(it->second);
         }
     }
-    statistics.currentGpuMemUseKB = memGpuUse / 1024;
-    statistics.currentRamMemUseKB = memRamUse / 1024;
-    uint64 memUse = memRamUse + memGpuUse;
-    // remove unconditionalToRemove
-    for (const Res &res : unconditionalToRemove)
+
+    // successfully loaded resources are removed
+    //   only when we are tight on memory
+    //   least recently used first
+    auto it = resources.lru.begin();
+    while (it != resources.lru.end())
     {
-        if (resourcesTryRemove(resources.resources[*res.n]))
-            memUse -= res.m;
+        const uint64 ram = resources.ramMemoryUse;
+        const uint64 gpu = resources.gpuMemoryUse;
+        const bool overTotal = ram + gpu > targetTotal;
+        const bool overGpu = targetGpu > 0 && gpu > targetGpu;
+        const bool overRam = targetRam > 0 && ram > targetRam;
+        if (!overTotal && !overGpu && !overRam)
+            break; // nothing else to remove
+        Resource *r = *it++;
+        // all following resources were used recently too
+        if (r->lastAccessTick + 5 >= renderTickIndex)
+            break;
+        if (overTotal
+            || (overGpu && r->info.gpuMemoryCost > 0)
+            || (overRam && r->info.ramMemoryCost > 0))
+        {
+            auto rit = resources.resources.find(r->name);
+            assert(rit != resources.resources.end());
+            if (rit != resources.resources.end())
+                resourcesTryRemove(rit->second);
+        }
     }
-    // remove resourcesToRemove
-    uint64 trs = (uint64)options.targetResourcesMemoryKB * 1024;
-    if (memUse > trs)
+
+    // prune expired entries from the key index
+    //   amortized by letting it grow to twice the number of resources
+    if (resources.resourcesByKey.size() > 2 * resources.resources.size() + 100)
     {
-        std::sort(resourcesToRemove.begin(), resourcesToRemove.end(),
-                  [](const Res &a, const Res &b){
-            return a.a < b.a; // least recently used first
-        });
-        for (const Res &res : resourcesToRemove)
+        auto &idx = resources.resourcesByKey;
+        for (auto kit = idx.begin(); kit != idx.end();)
         {
-            if (resourcesTryRemove(resources.resources[*res.n]))
-            {
-                memUse -= res.m;
-                if (memUse < trs)
-                    break;
-            }
+            if (kit->second.expired())
+                kit = idx.erase(kit);
+            else
+                kit++;
         }
     }
+
+    statistics.currentGpuMemUseKB = resources.gpuMemoryUse / 1024;
+    statistics.currentRamMemUseKB = resources.ramMemoryUse / 1024;
+    cacheUpdateStatistics();
+    const Resources::Counters &c = resources.counters;
+    statistics.resourcesDiskLoaded = c.resourcesDiskLoaded;
+    statistics.resourcesLocalLoaded = c.resourcesLocalLoaded;
+    statistics.resourcesDecoded = c.resourcesDecoded;
+    statistics.resourcesFailed = c.resourcesFailed;
+    statistics.resourcesCancelled = c.resourcesCancelled;
+    statistics.resourcesRevalidated = c.resourcesRevalidated;
+    for (uint32 i = 0; i < FetchTask::ResourceTypesCount; i++)
+    {
+        statistics.downloadedBytesTransferred[i]
+            = c.downloadedBytesTransferred[i];
+        statistics.downloadedBytesDecoded[i] = c.downloadedBytesDecoded[i];
+    }
+    for (uint32 i = 0; i < FetchTask::ResourceTypesCount; i++)
+        for (uint32 j = 0; j < MapStatistics::DownloadPhasesCount; j++)
+            for (uint32 k = 0; k < MapStatistics::DownloadLatencyBuckets; k++)
+                statistics.downloadLatency[i][j][k]
+                    = resources.downloadLatency[i][j][k];
 }
 
 void MapImpl::resourcesCheckInitialized()
@@ -599,9 +1065,11 @@ void MapImpl::resourcesCheckInitialized()
     OPTICK_EVENT();
     std::time_t current = std::time(nullptr);
 
-    for (const auto &it : resources.resources)
+    for (const auto &w : resources.pending)
     {
-        const std::shared_ptr<Resource> &r = it.second;
+        const std::shared_ptr<Resource> r = w.lock();
+        if (!r)
+            continue;
         if (r->lastAccessTick + 3 < renderTickIndex)
             continue; // skip resources that were not accessed last tick
         switch ((Resource::State)r->state)
@@ -612,7 +1080,7 @@ void MapImpl::resourcesCheckInitialized()
                 LOG(err3) << "All retries for resource <"
                     << r->name << "> has failed";
                 r->state = Resource::State::errorFatal;
-                statistics.resourcesFailed++;
+                resources.counters.resourcesFailed++;
                 break;
             }
             if (r->retryTime == -1)
@@ -646,28 +1114,87 @@ void MapImpl::resourcesStartDownloads()
 {
     OPTICK_EVENT();
     std::vector<std::weak_ptr<Resource>> requestCacheRead;
-    std::vector<std::weak_ptr<Resource>> requestDownloads;
+    std::vector<std::weak_ptr<Resource>> keep;
+    keep.reserve(resources.pending.size());
 
-    for (const auto &it : resources.resources)
+    for (auto &w : resources.pending)
     {
-        const std::shared_ptr<Resource> &r = it.second;
+        const std::shared_ptr<Resource> r = w.lock();
+        if (!r)
+            continue;
         switch ((Resource::State)r->state)
         {
         case Resource::State::checkCache:
             requestCacheRead.push_back(r);
+            keep.push_back(std::move(w));
             break;
         case Resource::State::startDownload:
-            requestDownloads.push_back(r);
+            // the resource waits in the fetcher queue
+            //   its priority is accumulated over one update period
+            r->fetchPriority = std::isnan(r->priority) ? 0 : r->priority;
+            if (r->priority < inf1())
+                r->priority = 0;
+            keep.push_back(std::move(w));
+            break;
+        case Resource::State::initializing:
+        case Resource::State::errorRetry:
+        case Resource::State::errorFatal:
+        case Resource::State::availFail:
+            keep.push_back(std::move(w));
             break;
         default:
+            // the state may have changed again in the meantime
+            r->pending = false;
+            if (pendingState(r->state) && !r->pending.exchange(true))
+                keep.push_back(std::move(w));
             break;
         }
     }
+    resources.pending.swap(keep);
 
     statistics.resourcesQueueCacheRead = requestCacheRead.size();
+    if (requestCacheRead.empty())
+        return;
     resources.queCacheRead.writeAll(requestCacheRead);
-    statistics.resourcesQueueDownload = requestDownloads.size();
-    resources.queFetching.writeAll(requestDownloads);
+    {
+        // wake up the cache reader waiting for the previous batch
+        std::lock_guard<std::mutex> lock(resources.cacheReadsMutex);
+    }
+    resources.cacheReadsCondition.notify_all();
+}
+
+void MapImpl::resourcesCancelDownloads()
+{
+    OPTICK_EVENT();
+    std::vector<std::weak_ptr<Resource>> inFlight;
+    {
+        std::lock_guard<std::mutex> lock(resources.downloadsInFlightMutex);
+        inFlight.swap(resources.downloadsInFlight);
+    }
+
+    // resources that were not accessed for a while have left the view
+    //   cancelling their downloads frees the slots for the needed ones
+    const uint32 ticks = options.cancelDownloadsAfterTicks;
+    std::vector<std::weak_ptr<Resource>> keep;
+    keep.reserve(inFlight.size());
+    for (auto &w : inFlight)
+    {
+        const std::shared_ptr<Resource> r = w.lock();
+        if (!r || r->state != Resource::State::downloading)
+            continue;
+        const std::shared_ptr<FetchTaskImpl> f = r->fetch;
+        if (f && ticks > 0 && r->lastAccessTick + ticks < renderTickIndex)
+        {
+            if (!f->cancelled.exchange(true))
+                LOG(debug) << "Cancelling download of <" << r->name << ">";
+            continue;
+        }
+        keep.push_back(std::move(w));
+    }
+
+    std::lock_guard<std::mutex> lock(resources.downloadsInFlightMutex);
+    resources.downloadsInFlight.insert(resources.downloadsInFlight.end(),
+        keep.begin(), keep.end());
 }
 
 void MapImpl::resourcesTerminateAllQueues()
@@ -678,7 +1205,17 @@ void MapImpl::resourcesTerminateAllQueues()
     resources.queAtmosphere.terminate();
     resources.queGeodata.terminate();
     resources.queCacheRead.terminate();
+    resources.queCacheReadWorkers.terminate();
+    {
+        std::lock_guard<std::mutex> lock(resources.cacheReadsMutex);
+    }
+    resources.cacheReadsCondition.notify_all();
     resources.queFetching.terminate();
+    {
+        std::lock_guard<std::mutex> lock(resources.downloadsMutex);
+        resources.downloadsBlocked.clear();
+    }
+    resources.downloadsCondition.notify_all();
 }
 
 void MapImpl::resourcesRenderFinalize()
@@ -689,7 +1226,14 @@ void MapImpl::resourcesRenderFinalize()
     purgeMapconfig();
 
     // clear the resources now while all the necessary things are still working
+    resources.resourcesByKey.clear();
     resources.resources.clear();
+    resources.lru.clear();
+    resources.pending.clear();
+    {
+        std::lock_guard<std::mutex> lock(resources.stateChangesMutex);
+        resources.stateChanges.clear();
+    }
 
     // allow the dataAllRun method to return to the caller
     resourcesTerminateAllQueues();
@@ -705,30 +1249,27 @@ void MapImpl::resourcesRenderUpdate()
         // resourcesPreparing is used to determine mapRenderComplete
         //   and must be updated every frame
         statistics.resourcesPreparing = 0;
-        for (const auto &it : resources.resources)
+        for (Resource::State state : { Resource::State::initializing,
+            Resource::State::checkCache, Resource::State::startDownload,
+            Resource::State::downloading, Resource::State::downloaded,
+            Resource::State::decoded })
         {
-            switch ((Resource::State)it.second->state)
-            {
-            case Resource::State::initializing:
-            case Resource::State::checkCache:
-            case Resource::State::startDownload:
-            case Resource::State::downloading:
-            case Resource::State::downloaded:
-            case Resource::State::decoded:
-                statistics.resourcesPreparing++;
-                break;
-            case Resource::State::ready:
-            case Resource::State::errorFatal:
-            case Resource::State::errorRetry:
-            case Resource::State::availFail:
-                break;
-            }
+            statistics.resourcesPreparing
+                += resources.statesCounts[(uint32)state];
         }
 
         statistics.resourcesActive
             = resources.resources.size();
         statistics.resourcesDownloading
             = resources.downloads;
+        statistics.resourcesDownloadsLimit
+            = options.adaptiveConcurrentDownloads
+            ? resources.downloadThrottle.limit()
+            : options.maxConcurrentDownloads;
+        statistics.downloadBandwidth
+            = resources.downloadThrottle.bandwidth();
+        statistics.resourcesQueueDownload
+            = resources.queFetching.estimateSize();
         statistics.resourcesQueueCacheWrite
             = resources.queCacheWrite.estimateSize();
         statistics.resourcesQueueDecode
@@ -741,12 +1282,21 @@ void MapImpl::resourcesRenderUpdate()
             = resources.queAtmosphere.estimateSize();
     }
 
+    resourcesCollectPending();
+
     // split workload into multiple render frames
     switch (renderTickIndex % 3)
     {
     case 0: return resourcesRemoveOld();
-    case 1: return resourcesCheckInitialized();
-    case 2: return resourcesStartDownloads();
+    case 1:
+        // move forward queued resources that became more important
+        resources.queFetching.reprioritize();
+        resources.queDecode.reprioritize();
+        resources.queUpload.reprioritize();
+        return resourcesCheckInitialized();
+    case 2:
+        resourcesCancelDownloads();
+        return resourcesStartDownloads();
     }
 }
 
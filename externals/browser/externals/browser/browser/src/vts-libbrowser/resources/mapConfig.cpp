@@ -49,12 +49,15 @@ void Mapconfig::decode()
 {
     assert(map->layers.empty());
     LOG(info2) << "Decoding mapconfig <" << name << ">";
+    std::unique_lock<std::shared_timed_mutex> lock(decodeMutex);
 
     // clear
     *(vtslibs::vts::MapConfig*)this = vtslibs::vts::MapConfig();
     browserOptions = BrowserOptions();
     atmosphereDensityTextureName = "";
-    convertorData.reset();
+    convertorsData.clear();
+    // the map clears its index of resources by url templates
+    //   before it uses the mapconfig again
     boundInfos.clear();
     freeInfos.clear();
 
@@ -64,6 +67,15 @@ void Mapconfig::decode()
         vtslibs::vts::loadMapConfig(*this, w, name);
     }
 
+    // local tilesets are read here, not in the render thread
+    {
+        std::vector<std::string> ids;
+        ids.reserve(surfaces.size());
+        for (const auto &it : surfaces)
+            ids.push_back(it.id);
+        map->resources.localTilesets.load(ids);
+    }
+
     // search url on earth
     if (isEarth() || map->createOptions.searchUrlFallbackOutsideEarth)
     {
@@ -113,17 +125,25 @@ void Mapconfig::decode()
     // referenceDivisionNodeInfos
     referenceDivisionNodeInfos.clear();
     referenceDivisionNodeInfos.reserve(referenceFrame.division.nodes.size());
+    referenceDivisionNodeIndices.clear();
     for (const auto &it : referenceFrame.division.nodes)
     {
+        referenceDivisionNodeIndices[it.first]
+            = referenceDivisionNodeInfos.size();
         referenceDivisionNodeInfos.emplace_back(
             referenceFrame, it.first, true, *this);
     }
 
-    // convertor for use in decode thread
-    convertorData = CoordManip::create(
-        *this, browserOptions.searchSrs,
-        map->createOptions.customSrs1,
-        map->createOptions.customSrs2);
+    // convertors for use in decoder threads
+    //   (the coordinate manipulators are not thread safe)
+    convertorsData.resize(map->resources.thrDecoders.size());
+    for (auto &it : convertorsData)
+    {
+        it = CoordManip::create(
+            *this, browserOptions.searchSrs,
+            map->createOptions.customSrs1,
+            map->createOptions.customSrs2);
+    }
 
     // memory use
     info.ramMemoryCost += sizeof(*this);
@@ -25,6 +25,7 @@
  */
 
 #include "../utilities/obj.hpp"
+#include "../utilities/meshV3.hpp"
 #include "../gpuResource.hpp"
 #include "../fetchTask.hpp"
 #include "../map.hpp"
@@ -63,6 +64,15 @@ GpuMesh::GpuMesh(MapImpl *map, const std::string &name) :
     Resource(map, name)
 {}
 
+GpuMesh::GpuMesh(MapImpl *map, const std::string &name,
+                 GpuMeshSpec &&spec) :
+    Resource(map, name)
+{
+    state = Resource::State::errorFatal;
+    faces = spec.indicesCount / 3;
+    decodeData = std::make_shared<GpuMeshSpec>(std::move(spec));
+}
+
 GpuMesh::GpuMesh(MapImpl *map, const std::string &name,
                  const vtslibs::vts::SubMesh &m) :
     Resource(map, name)
@@ -72,51 +82,12 @@ GpuMesh::GpuMesh(MapImpl *map, const std::string &name,
     assert(m.facesTc.size() == m.faces.size() || m.facesTc.empty());
     assert(m.etc.size() == m.vertices.size() || m.etc.empty());
 
-    uint32 vertexSize = sizeof(vec3f);
-    if (m.tc.size())
-        vertexSize += sizeof(vec2ui16);
-    if (m.etc.size())
-        vertexSize += sizeof(vec2ui16);
-
     GpuMeshSpec spec;
 
 #if 1 // indexed mesh
 
-    { // vertex attributes
-        uint32 offset = 0;
-
-        { // positions
-            spec.attributes[0].enable = true;
-            spec.attributes[0].components = 3;
-            spec.attributes[0].offset = offset;
-            spec.attributes[0].stride = vertexSize;
-            offset += sizeof(vec3f);
-        }
-
-        if (!m.tc.empty())
-        { // internal uv
-            spec.attributes[1].enable = true;
-            spec.attributes[1].type = GpuTypeEnum::UnsignedShort;
-            spec.attributes[1].components = 2;
-            spec.attributes[1].normalized = true;
-            spec.attributes[1].offset = offset;
-            spec.attributes[1].stride = vertexSize;
-            offset += sizeof(vec2ui16);
-        }
-
-        if (!m.etc.empty())
-        { // external uv
-            spec.attributes[2].enable = true;
-            spec.attributes[2].type = GpuTypeEnum::UnsignedShort;
-            spec.attributes[2].components = 2;
-            spec.attributes[2].normalized = true;
-            spec.attributes[2].offset = offset;
-            spec.attributes[2].stride = vertexSize;
-            offset += sizeof(vec2ui16);
-        }
-
-        assert(offset == vertexSize);
-    }
+    const uint32 vertexSize = surfaceMeshLayout(spec,
+        !m.tc.empty(), !m.etc.empty());
 
     if (m.tc.empty())
     {
@@ -209,6 +180,12 @@ GpuMesh::GpuMesh(MapImpl *map, const std::string &name,
 
 #else // indexed
 
+    uint32 vertexSize = sizeof(vec3f);
+    if (m.tc.size())
+        vertexSize += sizeof(vec2ui16);
+    if (m.etc.size())
+        vertexSize += sizeof(vec2ui16);
+
     spec.verticesCount = m.faces.size() * 3;
     spec.vertices.allocate(spec.verticesCount * vertexSize);
     uint32 offset = 0;
@@ -321,6 +298,23 @@ const mat4 findNormToPhys(const math::Extents3 &extents)
     return tr * sc;
 }
 
+MeshPart meshPart(MapImpl *map, const std::shared_ptr<GpuMesh> &gm,
+    const math::Extents3 &extents, uint32 textureLayer,
+    uint32 surfaceReference)
+{
+    const auto &spec = *std::static_pointer_cast
+            <GpuMeshSpec>(gm->decodeData);
+    MeshPart part;
+    part.renderable = gm;
+    part.normToPhys = findNormToPhys(extents)
+            * scaleMatrix(map->options.renderTilesScale);
+    part.internalUv = spec.attributes[1].enable;
+    part.externalUv = spec.attributes[2].enable;
+    part.textureLayer = textureLayer;
+    part.surfaceReference = surfaceReference;
+    return part;
+}
+
 } // namespace
 
 MeshAggregate::MeshAggregate(MapImpl *map, const std::string &name) :
@@ -331,11 +325,33 @@ void MeshAggregate::decode()
 {
     LOG(info2) << "Decoding (aggregated) mesh <" << name << ">";
 
+    submeshes.clear();
+
+    // meshes version 3 are decoded directly into the gpu layout
+    //   extraction of raw resources needs the vtslibs submeshes
+    if (!map->options.debugExtractRawResources)
+    {
+        std::vector<MeshV3Part> parts;
+        if (decodeMeshV3(fetch->reply.content, parts))
+        {
+            submeshes.reserve(parts.size());
+            for (uint32 mi = 0, me = parts.size(); mi != me; mi++)
+            {
+                MeshV3Part &p = parts[mi];
+                std::stringstream ss;
+                ss << name << "#" << mi;
+                submeshes.push_back(meshPart(map, std::make_shared<GpuMesh>(
+                    map, ss.str(), std::move(p.spec)),
+                    p.extents, p.textureLayer, p.surfaceReference));
+            }
+            return;
+        }
+    }
+
     detail::BufferStream w(fetch->reply.content);
     vtslibs::vts::NormalizedSubMesh::list meshes = vtslibs::vts::
             loadMeshProperNormalized(w, name);
 
-    submeshes.clear();
     submeshes.reserve(meshes.size());
 
     for (uint32 mi = 0, me = meshes.size(); mi != me; mi++)
@@ -347,16 +363,8 @@ void MeshAggregate::decode()
         std::shared_ptr<GpuMesh> gm
             = std::make_shared<GpuMesh>(map, ss.str(), m);
 
-        const auto &spec = *std::static_pointer_cast
-                <GpuMeshSpec>(gm->decodeData);
-        MeshPart part;
-        part.renderable = gm;
-        part.normToPhys = findNormToPhys(meshes[mi].extents)
-                * scaleMatrix(map->options.renderTilesScale);
-        part.internalUv = spec.attributes[1].enable;
-        part.externalUv = spec.attributes[2].enable;
-        part.textureLayer = m.textureLayer ? *m.textureLayer : 0;
-        part.surfaceReference = m.surfaceReference;
+        MeshPart part = meshPart(map, gm, meshes[mi].extents,
+            m.textureLayer ? *m.textureLayer : 0, m.surfaceReference);
         submeshes.push_back(part);
 
 #ifndef __EMSCRIPTEN__
@@ -32,6 +32,8 @@
 
 #include <dbglog/dbglog.hpp>
 
+#include <unordered_map>
+
 namespace vts
 {
 
@@ -52,9 +54,9 @@ vec3 lowerUpperCombine(uint32 i)
 } // namespace
 
 MetaNode::MetaNode() :
-    diskNormalPhys(nan3()),
+    diskNormalPhys(nan3().cast<float>()),
     diskHeightsPhys(nan2()),
-    diskHalfAngle(nan1()),
+    diskHalfAngle(std::numeric_limits<float>::quiet_NaN()),
     texelSize(inf1())
 {
     // initialize aabb to universe
@@ -69,6 +71,14 @@ vec3 MetaNode::cornersPhys(uint32 index) const
         aabbPhys[1] - aabbPhys[0]) + aabbPhys[0];
 }
 
+mat4 MetaNode::Obb::rotInv() const
+{
+    mat4 r = mat4::Identity();
+    r.block<3, 3>(0, 0) = axes.cast<double>();
+    r.block<3, 1>(0, 3) = center;
+    return r;
+}
+
 MetaTile::MetaTile(vts::MapImpl *map, const std::string &name) :
     Resource(map, name),
     vtslibs::vts::MetaTile(vtslibs::vts::TileId(), 0)
@@ -90,73 +100,115 @@ Extents2 subExtents(const Extents2 &parentExtents,
         parentExtents.ur(1) - lid.y * ts.height);
 }
 
-MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
-    const TileId &id, const vtslibs::vts::MetaNode &meta)
+namespace
 {
-    return generateMetaNode(m, m->map->convertor, id, meta);
-}
 
-MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
-    const std::shared_ptr<CoordManip> &cnv,
-    const vtslibs::vts::TileId &id, const vtslibs::vts::MetaNode &meta)
+const NodeInfo &findDivisionNode(const Mapconfig &m, TileId t)
 {
-    MetaNode node;
-    std::string srs;
+    while (true)
     {
-        TileId t = id;
-        while (true)
+        auto it = m.referenceDivisionNodeIndices.find(t);
+        if (it != m.referenceDivisionNodeIndices.end())
+            return m.referenceDivisionNodeInfos[it->second];
+        if (t.lod == 0)
         {
-            bool found = false;
-            for (const auto &d : m->referenceDivisionNodeInfos)
-            {
-                if (d.nodeId() != t)
-                    continue;
-                node.tileId = id;
-                node.localId = vtslibs::vts::local(d.nodeId().lod, id);
-                node.extents = subExtents(d.extents(), d.nodeId(), id);
-                srs = d.node().srs;
-                found = true;
-            }
-            if (found)
-                break;
-            assert(t.lod > 0);
-            t = vtslibs::vts::parent(t);
+            LOGTHROW(err2, std::runtime_error) << "Tile <" << t
+                << "> is not covered by any reference frame division node";
         }
-        assert(node.tileId == id);
+        t = vtslibs::vts::parent(t);
     }
+}
 
-    // corners
-    vec3 cornersPhys[8]; // oriented trapezoid bounding box corners
-    if (!vtslibs::vts::empty(meta.geomExtents)
-            && !srs.empty())
+// a metanode waiting for its points to be converted
+struct PendingNode
+{
+    const vtslibs::vts::MetaNode *meta = nullptr;
+    // points in the srs of the division node
+    //   converted to physical srs: 8 corners, 3 disk points, surrogate
+    //   converted to navigation srs: surrogate
+    std::vector<vec3> *phys = nullptr;
+    std::vector<vec3> *nav = nullptr;
+    uint32 physIndex = 0;
+    uint32 navIndex = 0;
+    bool corners = false;
+    bool disks = false;
+    bool surrogate = false;
+};
+
+void preparePoints(const Mapconfig &m, PendingNode &p, MetaNode &node,
+    std::unordered_map<std::string, std::vector<vec3>> &physBatches,
+    std::unordered_map<std::string, std::vector<vec3>> &navBatches)
+{
+    const vtslibs::vts::MetaNode &meta = *p.meta;
+    const TileId &id = node.tileId;
+    const NodeInfo &d = findDivisionNode(m, id);
+    node.localId = vtslibs::vts::local(d.nodeId().lod, id);
+    node.extents = subExtents(d.extents(), d.nodeId(), id);
+    const std::string &srs = d.node().srs;
+    if (srs.empty())
+        return;
+
+    p.corners = !vtslibs::vts::empty(meta.geomExtents);
+    p.disks = p.corners && id.lod > 4;
+    p.surrogate = vtslibs::vts::GeomExtents::validSurrogate(
+                meta.geomExtents.surrogate);
+    if (!p.corners && !p.surrogate)
+        return;
+
+    vec2 fl = vecFromUblas<vec2>(node.extents.ll);
+    vec2 fu = vecFromUblas<vec2>(node.extents.ur);
+    vec2 fc = (fu + fl) * 0.5;
+
+    p.phys = &physBatches[srs];
+    p.physIndex = p.phys->size();
+    if (p.corners)
     {
-        vec2 fl = vecFromUblas<vec2>(node.extents.ll);
-        vec2 fu = vecFromUblas<vec2>(node.extents.ur);
         vec3 el = vec2to3(fl, double(meta.geomExtents.z.min));
         vec3 eu = vec2to3(fu, double(meta.geomExtents.z.max));
         vec3 ed = eu - el;
         for (uint32 i = 0; i < 8; i++)
-        {
-            vec3 f = lowerUpperCombine(i).cwiseProduct(ed) + el;
-            f = cnv->convert(f, srs, Srs::Physical);
-            cornersPhys[i] = f;
-        }
+            p.phys->push_back(lowerUpperCombine(i).cwiseProduct(ed) + el);
+    }
+    if (p.disks)
+    {
+        p.phys->push_back(vec2to3(fc, double(meta.geomExtents.z.min)));
+        p.phys->push_back(vec2to3(fc, double(meta.geomExtents.z.max)));
+        p.phys->push_back(vec2to3(fu, double(meta.geomExtents.z.min)));
+    }
+    if (p.surrogate)
+    {
+        vec3 sds = vec2to3(fc, double(meta.geomExtents.surrogate));
+        p.phys->push_back(sds);
+        p.nav = &navBatches[srs];
+        p.navIndex = p.nav->size();
+        p.nav->push_back(sds);
+    }
+}
+
+void finishNode(const Mapconfig &m, const PendingNode &p, MetaNode &node)
+{
+    const vtslibs::vts::MetaNode &meta = *p.meta;
+    const TileId &id = node.tileId;
+    const vec3 *points = p.phys ? p.phys->data() + p.physIndex : nullptr;
+
+    // corners
+    vec3 cornersPhys[8]; // oriented trapezoid bounding box corners
+    if (p.corners)
+    {
+        for (uint32 i = 0; i < 8; i++)
+            cornersPhys[i] = *points++;
 
         // disks
-        if (id.lod > 4)
+        if (p.disks)
         {
-            vec2 sds2 = vec2((fu + fl) * 0.5);
-            vec3 sds = vec2to3(sds2, double(meta.geomExtents.z.min));
-            vec3 vn1 = cnv->convert(sds, srs, Srs::Physical);
-            node.diskNormalPhys = vn1.normalized();
+            const vec3 &vn1 = *points++;
+            const vec3 &vn2 = *points++;
+            const vec3 &vc = *points++;
+            node.diskNormalPhys = vn1.normalized().cast<float>();
             node.diskHeightsPhys[0] = vn1.norm();
-            sds = vec2to3(sds2, double(meta.geomExtents.z.max));
-            vec3 vn2 = cnv->convert(sds, srs, Srs::Physical);
             node.diskHeightsPhys[1] = vn2.norm();
-            sds = vec2to3(fu, double(meta.geomExtents.z.min));
-            vec3 vc = cnv->convert(sds, srs, Srs::Physical);
             node.diskHalfAngle = std::acos(
-                dot(node.diskNormalPhys, vc.normalized()));
+                dot(vn1.normalized(), vc.normalized()));
         }
     }
     else if (meta.extents.ll != meta.extents.ur)
@@ -165,9 +217,9 @@ MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
         vec3 fu = vecFromUblas<vec3>(meta.extents.ur);
         vec3 fd = fu - fl;
         vec3 el = vecFromUblas<vec3>
-                (m->referenceFrame.division.extents.ll);
+                (m.referenceFrame.division.extents.ll);
         vec3 eu = vecFromUblas<vec3>
-                (m->referenceFrame.division.extents.ur);
+                (m.referenceFrame.division.extents.ur);
         vec3 ed = eu - el;
         for (uint32 i = 0; i < 8; i++)
         {
@@ -195,18 +247,23 @@ MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
         vec3 u = cornersPhys[2] - cornersPhys[0];
         mat4 t = lookAt(center, center + f, u);
 
-        MetaNode::Obb obb;
-        obb.rotInv = t.inverse();
-        obb.points[0] = inf3();
-        obb.points[1] = -inf3();
-
+        vec3 points[2] = { inf3(), -inf3() };
         for (uint32 i = 0; i < 8; i++)
         {
             vec3 p = vec4to3(vec4(t * vec3to4(cornersPhys[i], 1)), false);
-            obb.points[0] = min(obb.points[0], p);
-            obb.points[1] = max(obb.points[1], p);
+            points[0] = min(points[0], p);
+            points[1] = max(points[1], p);
         }
 
+        // the box is rigid, its inverse is just the transposed rotation
+        //   the points are relative to the center
+        //   and are padded to cover the single precision rounding
+        MetaNode::Obb obb;
+        obb.axes = t.block<3, 3>(0, 0).transpose().cast<float>();
+        obb.center = center;
+        vec3 pad = vec3(1, 1, 1) * (points[1] - points[0]).norm() * 1e-6;
+        obb.points[0] = vec3(points[0] - pad).cast<float>();
+        obb.points[1] = vec3(points[1] + pad).cast<float>();
         node.obb = obb;
     }
 
@@ -222,15 +279,10 @@ MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
     }
 
     // surrogate
-    if (vtslibs::vts::GeomExtents::validSurrogate(
-                meta.geomExtents.surrogate))
+    if (p.surrogate)
     {
-        vec2 fl = vecFromUblas<vec2>(node.extents.ll);
-        vec2 fu = vecFromUblas<vec2>(node.extents.ur);
-        vec3 sds = vec2to3(vec2((fl + fu) * 0.5),
-                           double(meta.geomExtents.surrogate));
-        node.surrogatePhys = cnv->convert(sds, srs, Srs::Physical);
-        node.surrogateNav = cnv->convert(sds, srs, Srs::Navigation)[2];
+        node.surrogatePhys = *points++;
+        node.surrogateNav = (*p.nav)[p.navIndex][2];
     }
 
     // texelSize
@@ -249,10 +301,56 @@ MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
             node.texelSize = m / meta.displaySize;
         }
     }
+}
+
+} // namespace
+
+MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
+    const TileId &id, const vtslibs::vts::MetaNode &meta)
+{
+    return generateMetaNode(m, m->map->convertor, id, meta);
+}
 
+MetaNode generateMetaNode(const std::shared_ptr<Mapconfig> &m,
+    const std::shared_ptr<CoordManip> &cnv,
+    const vtslibs::vts::TileId &id, const vtslibs::vts::MetaNode &meta)
+{
+    MetaNode node;
+    const vtslibs::vts::MetaNode *pm = &meta;
+    generateMetaNodes(m, cnv, &id, &pm, &node, 1);
     return node;
 }
 
+void generateMetaNodes(const std::shared_ptr<Mapconfig> &m,
+    const std::shared_ptr<CoordManip> &cnv,
+    const vtslibs::vts::TileId *ids,
+    const vtslibs::vts::MetaNode *const *metas,
+    MetaNode *nodes, uint32 count)
+{
+    // gather points of all the nodes, grouped by their srs
+    std::unordered_map<std::string, std::vector<vec3>> physBatches;
+    std::unordered_map<std::string, std::vector<vec3>> navBatches;
+    std::vector<PendingNode> pending(count);
+    for (uint32 i = 0; i < count; i++)
+    {
+        pending[i].meta = metas[i];
+        nodes[i].tileId = ids[i];
+        preparePoints(*m, pending[i], nodes[i], physBatches, navBatches);
+    }
+
+    // convert each group at once
+    for (auto &it : physBatches)
+        cnv->convert(it.second.data(), it.second.size(),
+            it.first, Srs::Physical);
+    for (auto &it : navBatches)
+        cnv->convert(it.second.data(), it.second.size(),
+            it.first, Srs::Navigation);
+
+    // derive the bounding volumes
+    for (uint32 i = 0; i < count; i++)
+        finishNode(*m, pending[i], nodes[i]);
+}
+
 void MetaTile::decode()
 {
     std::shared_ptr<Mapconfig> m = mapconfig.lock();
@@ -261,6 +359,7 @@ void MetaTile::decode()
         LOGTHROW(err2, std::runtime_error) << "Decoding metatile after the "
             "corresponding mapconfig has expired";
     }
+    std::shared_lock<std::shared_timed_mutex> lock(m->decodeMutex);
 
     // decode the whole tile
     {
@@ -269,20 +368,20 @@ void MetaTile::decode()
                 m->referenceFrame.metaBinaryOrder, name);
     }
 
-    // precompute metanodes
-    metas.resize(size_ * size_);
-    vtslibs::vts::MetaTile::for_each([&](const vtslibs::vts::TileId &id,
+    // forced override
+    vtslibs::vts::MetaTile::for_each([&](const vtslibs::vts::TileId &,
         vtslibs::vts::MetaNode &node) {
-            if (node.flags() == 0)
-                return;
-            node.displaySize = 1024; // forced override
-            metas[(id.y - origin_.y) * size_ + id.x - origin_.x]
-                = generateMetaNode(m, m->convertorData, id, node);
+            if (node.flags() != 0)
+                node.displaySize = 1024;
         });
 
+    // the metanodes are generated on demand
+    metas.clear();
+    metas.resize(size_ * size_);
+
     info.ramMemoryCost += sizeof(*this);
     info.ramMemoryCost += size_ * size_
-        * (sizeof(vtslibs::vts::MetaNode) + sizeof(MetaNode));
+        * (sizeof(vtslibs::vts::MetaNode) + sizeof(metas[0]));
 }
 
 FetchTask::ResourceType MetaTile::resourceType() const
@@ -293,9 +392,51 @@ FetchTask::ResourceType MetaTile::resourceType() const
 std::shared_ptr<const MetaNode> MetaTile::getNode(const TileId &tileId)
 {
     const auto idx = index(tileId, false);
-    const boost::optional<MetaNode> &mn = metas[idx];
-    assert(mn);
-    return std::shared_ptr<const MetaNode>(shared_from_this(), mn.get_ptr());
+    if (!metas[idx])
+    {
+        std::shared_ptr<Mapconfig> m = mapconfig.lock();
+        if (!m)
+        {
+            LOGTHROW(err2, std::runtime_error) << "Accessing metatile after "
+                "the corresponding mapconfig has expired";
+        }
+        std::shared_lock<std::shared_timed_mutex> lock(m->decodeMutex);
+
+        // the traversal usually asks for all siblings together
+        //   so generate them in one batch
+        TileId ids[4];
+        const vtslibs::vts::MetaNode *nodes[4];
+        uint32 indices[4];
+        uint32 count = 0;
+        const TileId first(tileId.lod, tileId.x & ~1u, tileId.y & ~1u);
+        for (uint32 i = 0; i < 4; i++)
+        {
+            const TileId id(first.lod, first.x + i % 2, first.y + i / 2);
+            if (id.x < origin_.x || id.y < origin_.y
+                || id.x >= origin_.x + size_ || id.y >= origin_.y + size_)
+                continue;
+            const uint32 ix = index(id, false);
+            if (metas[ix] || (id != tileId && grid_[ix].flags() == 0))
+                continue;
+            ids[count] = id;
+            nodes[count] = &grid_[ix];
+            indices[count] = ix;
+            count++;
+        }
+        assert(count > 0);
+        MetaNode generated[4];
+        generateMetaNodes(m, map->convertor, ids, nodes, generated, count);
+        for (uint32 i = 0; i < count; i++)
+            metas[indices[i]] = std::make_unique<MetaNode>(generated[i]);
+
+        // the resource is already accounted in the map totals
+        const uint32 cost = count * sizeof(MetaNode);
+        info.ramMemoryCost += cost;
+        ramMemoryAccounted += cost;
+        map->resources.ramMemoryUse += cost;
+    }
+    return std::shared_ptr<const MetaNode>(shared_from_this(),
+        metas[idx].get());
 }
 
 } // namespace vts
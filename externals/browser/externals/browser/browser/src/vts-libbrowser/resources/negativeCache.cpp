@@ -0,0 +1,192 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../include/vts-browser/buffer.hpp"
+#include "../negativeCache.hpp"
+
+#include <boost/filesystem.hpp>
+#include <dbglog/dbglog.hpp>
+#include <optick.h>
+
+#include <cstring>
+#include <ctime>
+#include <vector>
+
+namespace vts
+{
+
+namespace
+{
+
+static const char Magic[] = "vtsnegative";
+static const uint32 Version = 1;
+
+struct FileHeader
+{
+    char magic[16];
+    uint32 version;
+    uint32 count;
+};
+
+struct FileEntry
+{
+    NegativeCache::Digest digest;
+    sint64 expires;
+};
+
+} // namespace
+
+NegativeCache::NegativeCache(const std::string &path) : path(path)
+{
+    OPTICK_EVENT();
+    if (!boost::filesystem::exists(path))
+        return;
+    try
+    {
+        Buffer b = readLocalFileBuffer(path);
+        FileHeader h;
+        if (b.size() < sizeof(FileHeader))
+            LOGTHROW(err2, std::runtime_error) << "File is too short";
+        memcpy(&h, b.data(), sizeof(FileHeader));
+        if (memcmp(h.magic, Magic, sizeof(Magic)) != 0
+            || h.version != Version)
+            LOGTHROW(err2, std::runtime_error) << "Invalid file header";
+        if (b.size() != sizeof(FileHeader)
+            + uint64(h.count) * sizeof(FileEntry))
+            LOGTHROW(err2, std::runtime_error) << "Invalid file size";
+        const std::time_t now = std::time(nullptr);
+        const char *p = b.data() + sizeof(FileHeader);
+        for (uint32 i = 0; i < h.count; i++)
+        {
+            FileEntry e;
+            memcpy(&e, p + i * sizeof(FileEntry), sizeof(FileEntry));
+            if (e.expires > now)
+                entries.emplace_hint(entries.end(), e.digest, e.expires);
+            else
+                modified = true;
+        }
+        LOG(info2) << "Loaded " << entries.size()
+            << " missing resources from <" << path << ">";
+    }
+    catch (const std::exception &e)
+    {
+        LOG(warn2) << "Failed to load missing resources from <"
+            << path << ">, <" << e.what() << ">";
+        entries.clear();
+        modified = true;
+    }
+}
+
+NegativeCache::~NegativeCache()
+{
+    save();
+}
+
+bool NegativeCache::contains(const Digest &digest)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    auto it = entries.find(digest);
+    if (it == entries.end())
+        return false;
+    if (it->second > std::time(nullptr))
+        return true;
+    entries.erase(it);
+    modified = true;
+    return false;
+}
+
+void NegativeCache::insert(const Digest &digest, sint64 expires)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    entries[digest] = expires;
+    modified = true;
+}
+
+void NegativeCache::remove(const Digest &digest)
+{
+    std::lock_guard<std::mutex> lock(mut);
+    if (entries.erase(digest))
+        modified = true;
+}
+
+void NegativeCache::save()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    saveLocked();
+}
+
+void NegativeCache::saveLocked()
+{
+    if (!modified)
+        return;
+    OPTICK_EVENT();
+    try
+    {
+        const std::time_t now = std::time(nullptr);
+        std::vector<FileEntry> es;
+        es.reserve(entries.size());
+        for (const auto &it : entries)
+        {
+            if (it.second <= now)
+                continue;
+            FileEntry e;
+            e.digest = it.first;
+            e.expires = it.second;
+            es.push_back(e);
+        }
+        FileHeader h;
+        memset(&h, 0, sizeof(FileHeader)); // initialize structure padding
+        memcpy(h.magic, Magic, sizeof(Magic));
+        h.version = Version;
+        h.count = es.size();
+        detail::writeLocalFileParts(path, {
+            { &h, sizeof(FileHeader) },
+            { es.data(), uint32(es.size() * sizeof(FileEntry)) } });
+        modified = false;
+    }
+    catch (const std::exception &e)
+    {
+        LOG(warn2) << "Failed to save missing resources into <"
+            << path << ">, <" << e.what() << ">";
+    }
+}
+
+void NegativeCache::purge()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    entries.clear();
+    modified = false;
+    boost::system::error_code ec;
+    boost::filesystem::remove(path, ec);
+}
+
+uint32 NegativeCache::size()
+{
+    std::lock_guard<std::mutex> lock(mut);
+    return entries.size();
+}
+
+} // namespace vts
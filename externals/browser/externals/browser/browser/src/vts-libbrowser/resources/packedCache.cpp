@@ -0,0 +1,857 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "../packedCache.hpp"
+
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include <boost/interprocess/sync/file_lock.hpp>
+#include <dbglog/dbglog.hpp>
+#include <optick.h>
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace vts
+{
+
+namespace
+{
+
+namespace bip = boost::interprocess;
+
+static const char IndexMagic[] = "vtspackindex";
+static const char SegmentMagic[] = "vtspacksegment";
+static const char SegmentPrefix[] = "segment-";
+static const uint32 Version = 1;
+static const uint32 SegmentCapacity = 64 * 1024 * 1024;
+static const uint32 IndexInitialCapacity = 1 << 14;
+static const uint32 RecordAlignment = 8;
+// bounds the time the records are blocked by one compaction
+static const uint64 CompactionMaxBytes = SegmentCapacity / 2;
+
+struct IndexHeader
+{
+    char magic[16];
+    uint32 version;
+    uint32 capacity; // number of slots, power of two
+    uint32 occupied; // live and deleted slots
+    uint32 live;
+    uint32 activeSegment; // 0 = none
+    uint32 padding[3];
+};
+
+enum class SlotState : uint32
+{
+    Empty = 0, // must be zero - new index files are zero filled
+    Live = 1,
+    Deleted = 2,
+};
+
+struct IndexSlot
+{
+    unsigned char digest[16];
+    uint32 state;
+    uint32 segment;
+    uint32 offset;
+    uint32 size;
+    uint32 accessed; // time of last read or write
+    uint32 padding;
+    sint64 expires;
+};
+
+struct SegmentHeader
+{
+    char magic[16];
+    uint32 version;
+    uint32 capacity;
+    uint32 used; // bytes including this header
+    uint32 padding;
+};
+
+static_assert(sizeof(IndexSlot) == 48, "unexpected index slot size");
+static_assert(sizeof(SegmentHeader) % RecordAlignment == 0,
+    "misaligned segment header");
+
+uint32 currentTime()
+{
+    return (uint32)std::time(nullptr);
+}
+
+uint32 alignRecord(uint32 size)
+{
+    return (size + RecordAlignment - 1) / RecordAlignment * RecordAlignment;
+}
+
+bip::mapped_region openMapped(const std::string &path)
+{
+    bip::file_mapping f(path.c_str(), bip::read_write);
+    return bip::mapped_region(f, bip::read_write);
+}
+
+// the space is allocated on the disk upfront
+//   writing into a mapped sparse file crashes (SIGBUS) when the disk is full
+void allocateFile(const std::string &path, uint64 size)
+{
+#ifdef __linux__
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Failed to create file <" << path << ">";
+    }
+    int e = posix_fallocate(fd, 0, size);
+    ::close(fd);
+    if (e != 0)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Failed to allocate file <" << path << ">, <"
+            << std::strerror(e) << ">";
+    }
+#else
+    std::ofstream f(path, std::ios::binary | std::ios::trunc);
+    if (!f)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Failed to create file <" << path << ">";
+    }
+    static const std::vector<char> zeros(1024 * 1024);
+    while (size > 0 && f)
+    {
+        uint64 n = std::min<uint64>(size, zeros.size());
+        f.write(zeros.data(), n);
+        size -= n;
+    }
+    f.flush();
+    if (!f)
+    {
+        LOGTHROW(err2, std::runtime_error)
+            << "Failed to allocate file <" << path << ">";
+    }
+#endif
+}
+
+// the file is zero filled
+bip::mapped_region createMapped(const std::string &path, uint64 size)
+{
+    try
+    {
+        allocateFile(path, size);
+    }
+    catch (...)
+    {
+        boost::system::error_code ec;
+        boost::filesystem::remove(path, ec);
+        throw;
+    }
+    return openMapped(path);
+}
+
+IndexHeader *indexHeader(const bip::mapped_region &r)
+{
+    return (IndexHeader*)r.get_address();
+}
+
+IndexSlot *indexSlots(const bip::mapped_region &r)
+{
+    return (IndexSlot*)((char*)r.get_address() + sizeof(IndexHeader));
+}
+
+// returns slot with the digest
+//   or the slot where the digest should be inserted
+uint32 findSlot(const bip::mapped_region &r,
+    const PackedCache::Digest &digest, bool &found)
+{
+    const IndexHeader *h = indexHeader(r);
+    const IndexSlot *s = indexSlots(r);
+    const uint32 mask = h->capacity - 1;
+    uint32 i;
+    memcpy(&i, digest.data(), sizeof(i)); // md5 is uniformly distributed
+    i &= mask;
+    uint32 insert = (uint32)-1;
+    while (true)
+    {
+        const IndexSlot &t = s[i];
+        switch ((SlotState)t.state)
+        {
+        case SlotState::Empty:
+            found = false;
+            return insert == (uint32)-1 ? i : insert;
+        case SlotState::Deleted:
+            if (insert == (uint32)-1)
+                insert = i;
+            break;
+        case SlotState::Live:
+            if (memcmp(t.digest, digest.data(), digest.size()) == 0)
+            {
+                found = true;
+                return i;
+            }
+            break;
+        }
+        i = (i + 1) & mask;
+    }
+}
+
+class Segment
+{
+public:
+    Segment(bip::mapped_region &&region) : region(std::move(region))
+    {}
+
+    SegmentHeader *header() const
+    {
+        return (SegmentHeader*)region.get_address();
+    }
+
+    char *data() const
+    {
+        return (char*)region.get_address();
+    }
+
+    bip::mapped_region region;
+    uint64 liveBytes = 0;
+};
+
+// paths of all packed caches opened in this process
+//   the file lock does not prevent opening it twice from the same process
+std::mutex openedPathsMutex;
+std::set<std::string> openedPaths;
+
+class PackedCacheImpl : public PackedCache
+{
+public:
+    std::mutex mut;
+    std::string path;
+    bip::file_lock lock;
+    bip::mapped_region index;
+    std::map<uint32, std::shared_ptr<Segment>> segments;
+
+    PackedCacheImpl(const std::string &pathParam) : path(pathParam)
+    {
+        if (path.back() != '/')
+            path += "/";
+        {
+            std::lock_guard<std::mutex> l(openedPathsMutex);
+            if (!openedPaths.insert(path).second)
+            {
+                LOGTHROW(err3, std::runtime_error)
+                    << "Packed disk cache <" << path
+                    << "> is already opened";
+            }
+        }
+        try
+        {
+            boost::filesystem::create_directories(path);
+            std::string lockPath = path + "lock";
+            {
+                std::ofstream f(lockPath, std::ios::app);
+            }
+            lock = bip::file_lock(lockPath.c_str());
+            if (!lock.try_lock())
+            {
+                LOGTHROW(err3, std::runtime_error)
+                    << "Packed disk cache <" << path
+                    << "> is used by another process";
+            }
+            open();
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> l(openedPathsMutex);
+            openedPaths.erase(path);
+            throw;
+        }
+    }
+
+    ~PackedCacheImpl()
+    {
+        segments.clear();
+        index = bip::mapped_region();
+        std::lock_guard<std::mutex> l(openedPathsMutex);
+        openedPaths.erase(path);
+    }
+
+    std::string indexPath() const
+    {
+        return path + "index";
+    }
+
+    std::string segmentPath(uint32 id) const
+    {
+        std::ostringstream ss;
+        ss << path << SegmentPrefix << std::hex << std::setw(8)
+            << std::setfill('0') << id;
+        return ss.str();
+    }
+
+    // returns 0 for files that are not segments
+    static uint32 segmentId(const boost::filesystem::path &p)
+    {
+        std::string n = p.filename().string();
+        std::string prefix = SegmentPrefix;
+        if (n.size() <= prefix.size() || n.substr(0, prefix.size()) != prefix)
+            return 0;
+        try
+        {
+            return std::stoul(n.substr(prefix.size()), nullptr, 16);
+        }
+        catch (...)
+        {
+            return 0;
+        }
+    }
+
+    IndexHeader *header() const
+    {
+        return indexHeader(index);
+    }
+
+    IndexSlot *slots() const
+    {
+        return indexSlots(index);
+    }
+
+    void open()
+    {
+        if (boost::filesystem::exists(indexPath()))
+        {
+            try
+            {
+                index = openMapped(indexPath());
+                validateIndex();
+                openSegments();
+                return;
+            }
+            catch (const std::exception &e)
+            {
+                LOG(warn3) << "Packed disk cache index is invalid, "
+                    "the cache will be reset, <" << e.what() << ">";
+            }
+        }
+        reset();
+    }
+
+    void validateIndex()
+    {
+        if (index.get_size() < sizeof(IndexHeader))
+            LOGTHROW(err2, std::runtime_error) << "Index too small";
+        const IndexHeader *h = header();
+        if (memcmp(h->magic, IndexMagic, sizeof(IndexMagic)) != 0)
+            LOGTHROW(err2, std::runtime_error) << "Invalid index magic";
+        if (h->version != Version)
+            LOGTHROW(err2, std::runtime_error) << "Invalid index version";
+        if (h->capacity == 0 || (h->capacity & (h->capacity - 1)) != 0
+            || index.get_size() < sizeof(IndexHeader)
+                + uint64(h->capacity) * sizeof(IndexSlot))
+            LOGTHROW(err2, std::runtime_error) << "Invalid index capacity";
+    }
+
+    void openSegments()
+    {
+        IndexHeader *h = header();
+        IndexSlot *s = slots();
+        h->occupied = 0;
+        h->live = 0;
+        for (uint32 i = 0; i < h->capacity; i++)
+        {
+            IndexSlot &t = s[i];
+            switch ((SlotState)t.state)
+            {
+            case SlotState::Empty:
+                continue;
+            case SlotState::Live:
+            {
+                Segment *seg = segment(t.segment);
+                if (seg && uint64(t.offset) + t.size <= seg->header()->used)
+                {
+                    seg->liveBytes += t.size;
+                    h->live++;
+                }
+                else
+                    t.state = (uint32)SlotState::Deleted; // the record is lost
+            } break;
+            default:
+                t.state = (uint32)SlotState::Deleted;
+                break;
+            }
+            h->occupied++;
+        }
+        segment(h->activeSegment);
+
+        // remove segments that are not referenced
+        //   eg. compacted segments that were still in use at the time
+        for (const auto &it : boost::filesystem::directory_iterator(path))
+        {
+            uint32 id = segmentId(it.path());
+            if (id == 0 || segments.count(id))
+                continue;
+            boost::system::error_code ec;
+            boost::filesystem::remove(it.path(), ec);
+        }
+
+        LOG(info2) << "Opened packed disk cache with " << h->live
+            << " records in " << segments.size() << " segments";
+    }
+
+    // returns nullptr if the segment does not exist or is invalid
+    Segment *segment(uint32 id)
+    {
+        if (id == 0)
+            return nullptr;
+        auto it = segments.find(id);
+        if (it != segments.end())
+            return it->second.get();
+        std::string p = segmentPath(id);
+        if (!boost::filesystem::exists(p))
+            return nullptr;
+        try
+        {
+            auto seg = std::make_shared<Segment>(openMapped(p));
+            const SegmentHeader *h = seg->header();
+            if (seg->region.get_size() < sizeof(SegmentHeader)
+                || memcmp(h->magic, SegmentMagic, sizeof(SegmentMagic)) != 0
+                || h->version != Version
+                || h->capacity > seg->region.get_size()
+                || h->used > h->capacity)
+                return nullptr;
+            segments[id] = seg;
+            return seg.get();
+        }
+        catch (const std::exception &e)
+        {
+            LOG(warn2) << "Failed to open packed disk cache segment <"
+                << p << ">, <" << e.what() << ">";
+            return nullptr;
+        }
+    }
+
+    // removes all records
+    void reset()
+    {
+        OPTICK_EVENT();
+        segments.clear();
+        index = bip::mapped_region();
+        uint32 lastId = 0;
+        for (const auto &it : boost::filesystem::directory_iterator(path))
+        {
+            if (it.path().filename() == "lock")
+                continue;
+            // segments may still be used by previously read records
+            //   and may not be removable on some systems
+            //   continue numbering after them
+            lastId = std::max(lastId, segmentId(it.path()));
+            boost::system::error_code ec;
+            boost::filesystem::remove(it.path(), ec);
+        }
+        index = createIndex(indexPath(), IndexInitialCapacity);
+        header()->activeSegment = lastId;
+    }
+
+    bip::mapped_region createIndex(const std::string &p, uint32 capacity)
+    {
+        bip::mapped_region r = createMapped(p, sizeof(IndexHeader)
+            + uint64(capacity) * sizeof(IndexSlot));
+        IndexHeader *h = indexHeader(r);
+        memcpy(h->magic, IndexMagic, sizeof(IndexMagic));
+        h->version = Version;
+        h->capacity = capacity;
+        return r;
+    }
+
+    // make sure that there is space for one more slot
+    void reserveSlot()
+    {
+        const IndexHeader *h = header();
+        if (uint64(h->occupied + 1) * 10 < uint64(h->capacity) * 7)
+            return;
+        uint32 capacity = h->capacity;
+        if (uint64(h->live + 1) * 10 >= uint64(capacity) * 4)
+            capacity *= 2; // otherwise just drop the deleted slots
+        rebuildIndex(capacity);
+    }
+
+    void rebuildIndex(uint32 capacity)
+    {
+        OPTICK_EVENT();
+        std::string tmpPath = indexPath() + ".tmp";
+        {
+            bip::mapped_region r = createIndex(tmpPath, capacity);
+            IndexHeader *nh = indexHeader(r);
+            IndexSlot *ns = indexSlots(r);
+            const IndexHeader *h = header();
+            const IndexSlot *s = slots();
+            for (uint32 i = 0; i < h->capacity; i++)
+            {
+                if (s[i].state != (uint32)SlotState::Live)
+                    continue;
+                Digest d;
+                memcpy(d.data(), s[i].digest, d.size());
+                bool found;
+                uint32 j = findSlot(r, d, found);
+                assert(!found);
+                ns[j] = s[i];
+                nh->occupied++;
+                nh->live++;
+            }
+            nh->activeSegment = h->activeSegment;
+        }
+        index = bip::mapped_region();
+        boost::filesystem::rename(tmpPath, indexPath());
+        index = openMapped(indexPath());
+        LOG(info1) << "Rebuilt packed disk cache index with capacity "
+            << capacity;
+    }
+
+    // returns nullptr if the segment cannot be allocated, eg. the disk is full
+    Segment *startSegment(uint32 minCapacity)
+    {
+        IndexHeader *h = header();
+        uint32 id = h->activeSegment + 1;
+        uint32 capacity = std::max(SegmentCapacity, minCapacity);
+        std::shared_ptr<Segment> s;
+        try
+        {
+            s = std::make_shared<Segment>(
+                createMapped(segmentPath(id), capacity));
+        }
+        catch (const std::exception &e)
+        {
+            LOG(warn2) << "Failed to allocate packed disk cache segment, <"
+                << e.what() << ">";
+            return nullptr;
+        }
+        SegmentHeader *sh = s->header();
+        memcpy(sh->magic, SegmentMagic, sizeof(SegmentMagic));
+        sh->version = Version;
+        sh->capacity = capacity;
+        sh->used = sizeof(SegmentHeader);
+        segments[id] = s;
+        h->activeSegment = id;
+        return s.get();
+    }
+
+    // returns false if there is no space for the record
+    //   started is set if new segment was started
+    bool append(const std::vector<Part> &parts, uint32 size,
+        uint32 &segmentId, uint32 &offset, bool &started)
+    {
+        IndexHeader *h = header();
+        const uint32 aligned = alignRecord(size);
+        Segment *seg = segment(h->activeSegment);
+        if (!seg || uint64(seg->header()->used) + aligned
+            > seg->header()->capacity)
+        {
+            seg = startSegment(sizeof(SegmentHeader) + aligned);
+            if (!seg)
+                return false;
+            started = true;
+        }
+        segmentId = h->activeSegment;
+        offset = seg->header()->used;
+        char *p = seg->data() + offset;
+        for (const Part &it : parts)
+        {
+            memcpy(p, it.first, it.second);
+            p += it.second;
+        }
+        seg->header()->used += aligned;
+        return true;
+    }
+
+    void release(const IndexSlot &t)
+    {
+        auto it = segments.find(t.segment);
+        if (it != segments.end())
+            it->second->liveBytes -= t.size;
+    }
+
+    Record read(const Digest &digest)
+    {
+        std::lock_guard<std::mutex> l(mut);
+        bool found;
+        uint32 i = findSlot(index, digest, found);
+        if (!found)
+            return {};
+        const IndexSlot &t = slots()[i];
+        auto it = segments.find(t.segment);
+        if (it == segments.end())
+            return {};
+        slots()[i].accessed = currentTime();
+        Record r;
+        r.data = it->second->data() + t.offset;
+        r.size = t.size;
+        r.owner = it->second;
+        return r;
+    }
+
+    bool write(const Digest &digest, const std::vector<Part> &parts,
+        sint64 expires)
+    {
+        std::lock_guard<std::mutex> l(mut);
+        uint32 size = 0;
+        for (const Part &it : parts)
+            size += it.second;
+        reserveSlot();
+        uint32 segmentId, offset;
+        bool started = false;
+        if (!append(parts, size, segmentId, offset, started))
+            return false;
+        IndexHeader *h = header();
+        bool found;
+        uint32 i = findSlot(index, digest, found);
+        IndexSlot &t = slots()[i];
+        if (found)
+            release(t);
+        else
+        {
+            if (t.state == (uint32)SlotState::Empty)
+                h->occupied++;
+            h->live++;
+            memcpy(t.digest, digest.data(), digest.size());
+        }
+        t.segment = segmentId;
+        t.offset = offset;
+        t.size = size;
+        t.accessed = currentTime();
+        t.expires = expires;
+        t.state = (uint32)SlotState::Live;
+        segments[segmentId]->liveBytes += size;
+        if (started)
+            compactLocked(0.5);
+        return true;
+    }
+
+    void remove(const Digest &digest)
+    {
+        std::lock_guard<std::mutex> l(mut);
+        bool found;
+        uint32 i = findSlot(index, digest, found);
+        if (!found)
+            return;
+        IndexSlot &t = slots()[i];
+        release(t);
+        t.state = (uint32)SlotState::Deleted;
+        header()->live--;
+    }
+
+    // compacts segments with larger portion of garbage than the ratio
+    //   the segments with most garbage first,
+    //   up to CompactionMaxBytes of live records are moved in one call
+    void compactLocked(double garbageRatio)
+    {
+        OPTICK_EVENT();
+        const IndexHeader *h = header();
+        std::vector<std::pair<double, uint32>> candidates;
+        for (const auto &it : segments)
+        {
+            if (it.first == h->activeSegment)
+                continue;
+            uint64 used = it.second->header()->used - sizeof(SegmentHeader);
+            uint64 garbage = used - it.second->liveBytes;
+            if (garbage > used * garbageRatio)
+                candidates.emplace_back(double(garbage) / used, it.first);
+        }
+        if (candidates.empty())
+            return;
+        std::sort(candidates.begin(), candidates.end(),
+            std::greater<std::pair<double, uint32>>());
+        std::vector<uint32> victims;
+        uint64 moved = 0;
+        for (const auto &it : candidates)
+        {
+            uint64 live = segments[it.second]->liveBytes;
+            if (!victims.empty() && moved + live > CompactionMaxBytes)
+                break;
+            moved += live;
+            victims.push_back(it.second);
+        }
+        std::sort(victims.begin(), victims.end());
+        LOG(info2) << "Compacting " << victims.size()
+            << " packed disk cache segments";
+        IndexSlot *s = slots();
+        for (uint32 i = 0; i < h->capacity; i++)
+        {
+            IndexSlot &t = s[i];
+            if (t.state != (uint32)SlotState::Live
+                || !std::binary_search(victims.begin(), victims.end(),
+                    t.segment))
+                continue;
+            Segment *from = segments[t.segment].get();
+            uint32 segmentId, offset;
+            bool started = false;
+            if (!append({ { from->data() + t.offset, t.size } }, t.size,
+                segmentId, offset, started))
+                break; // the rest stays in place
+            from->liveBytes -= t.size;
+            segments[segmentId]->liveBytes += t.size;
+            t.segment = segmentId;
+            t.offset = offset;
+        }
+        for (uint32 id : victims)
+        {
+            if (segments[id]->liveBytes > 0)
+                continue;
+            segments.erase(id);
+            // the removal fails on some systems while the segment is mapped
+            //   it will be removed when the cache is opened next time
+            boost::system::error_code ec;
+            boost::filesystem::remove(segmentPath(id), ec);
+        }
+    }
+
+    void compact()
+    {
+        std::lock_guard<std::mutex> l(mut);
+        compactLocked(0.5);
+    }
+
+    uint32 evict(uint64 targetSize)
+    {
+        std::lock_guard<std::mutex> l(mut);
+        OPTICK_EVENT();
+        const sint64 now = std::time(nullptr);
+        IndexHeader *h = header();
+        IndexSlot *s = slots();
+        uint64 live = 0;
+        for (const auto &it : segments)
+            live += it.second->liveBytes;
+        uint32 evicted = 0;
+        std::vector<uint32> candidates;
+        candidates.reserve(h->live);
+        for (uint32 i = 0; i < h->capacity; i++)
+        {
+            IndexSlot &t = s[i];
+            if (t.state != (uint32)SlotState::Live)
+                continue;
+            if (t.expires > 0 && t.expires < now)
+            {
+                release(t);
+                t.state = (uint32)SlotState::Deleted;
+                h->live--;
+                live -= t.size;
+                evicted++;
+            }
+            else
+                candidates.push_back(i);
+        }
+        if (live > targetSize)
+        {
+            std::sort(candidates.begin(), candidates.end(),
+                [&](uint32 a, uint32 b) {
+                    return s[a].accessed < s[b].accessed;
+                });
+            for (uint32 i : candidates)
+            {
+                if (live <= targetSize)
+                    break;
+                IndexSlot &t = s[i];
+                release(t);
+                t.state = (uint32)SlotState::Deleted;
+                h->live--;
+                live -= t.size;
+                evicted++;
+            }
+        }
+        compactLocked(0.5);
+        return evicted;
+    }
+
+    uint64 size()
+    {
+        std::lock_guard<std::mutex> l(mut);
+        uint64 r = index.get_size();
+        for (const auto &it : segments)
+            r += it.second->header()->used;
+        return r;
+    }
+
+    void purge()
+    {
+        std::lock_guard<std::mutex> l(mut);
+        reset();
+    }
+};
+
+} // namespace
+
+std::shared_ptr<PackedCache> PackedCache::create(const std::string &path)
+{
+    return std::make_shared<PackedCacheImpl>(path);
+}
+
+PackedCache::Record PackedCache::read(const Digest &digest)
+{
+    return ((PackedCacheImpl*)this)->read(digest);
+}
+
+bool PackedCache::write(const Digest &digest, const std::vector<Part> &parts,
+    sint64 expires)
+{
+    return ((PackedCacheImpl*)this)->write(digest, parts, expires);
+}
+
+void PackedCache::remove(const Digest &digest)
+{
+    ((PackedCacheImpl*)this)->remove(digest);
+}
+
+void PackedCache::compact()
+{
+    ((PackedCacheImpl*)this)->compact();
+}
+
+uint32 PackedCache::evict(uint64 targetSize)
+{
+    return ((PackedCacheImpl*)this)->evict(targetSize);
+}
+
+uint64 PackedCache::size()
+{
+    return ((PackedCacheImpl*)this)->size();
+}
+
+void PackedCache::purge()
+{
+    ((PackedCacheImpl*)this)->purge();
+}
+
+} // namespace vts
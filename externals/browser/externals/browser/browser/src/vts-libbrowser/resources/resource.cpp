@@ -28,9 +28,40 @@
 #include "../fetchTask.hpp"
 #include "../map.hpp"
 
+#include <cstdio>
+#include <ctime>
+
 namespace vts
 {
 
+namespace
+{
+
+// formats the time as required by the http headers
+//   the names are not localized
+std::string httpDate(sint64 time)
+{
+    static const char *const Days[] = {
+        "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+    static const char *const Months[] = {
+        "Jan", "Feb", "Mar", "Apr", "May", "Jun",
+        "Jul", "Aug", "Sep", "Oct", "Nov", "Dec" };
+    std::time_t t = time;
+    std::tm tm;
+#ifdef _WIN32
+    gmtime_s(&tm, &t);
+#else
+    gmtime_r(&t, &tm);
+#endif
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%s, %02d %s %04d %02d:%02d:%02d GMT",
+        Days[tm.tm_wday], tm.tm_mday, Months[tm.tm_mon],
+        tm.tm_year + 1900, tm.tm_hour, tm.tm_min, tm.tm_sec);
+    return buf;
+}
+
+} // namespace
+
 FetchTaskImpl::FetchTaskImpl(const std::shared_ptr<Resource> &resource) :
 	FetchTask(resource->name, resource->resourceType()),
     name(resource->name), map(resource->map), resource(resource)
@@ -62,8 +93,34 @@ bool FetchTaskImpl::performAvailTest() const
     return true;
 }
 
+void FetchTaskImpl::revalidate(Buffer &&content, const std::string &etag,
+    sint64 lastModified, bool availFailed)
+{
+    revalidation.content = std::move(content);
+    revalidation.etag = etag;
+    revalidation.lastModified = lastModified;
+    revalidation.availFailed = availFailed;
+    revalidation.active = true;
+    if (!etag.empty())
+        query.headers["If-None-Match"] = etag;
+    if (lastModified >= 0)
+        query.headers["If-Modified-Since"] = httpDate(lastModified);
+}
+
+Resource::AtomicState::AtomicState(Resource *resource) :
+    resource(resource)
+{}
+
+Resource::AtomicState &Resource::AtomicState::operator = (State s)
+{
+    State old = value.exchange(s);
+    if (old != s && resource->tracked)
+        resource->map->resourceStateChanged(resource, old, s);
+    return *this;
+}
+
 Resource::Resource(vts::MapImpl *map, const std::string &name) :
-    name(name), map(map),
+    name(name), map(map), state(this),
     priority(nan1())
 {
     LOG(debug) << "Constructing resource <" << name
@@ -74,6 +131,15 @@ Resource::~Resource()
 {
     LOG(debug) << "Destroying resource <" << name
                << "> at <" << this << ">";
+    // nobody would receive the result of the download
+    if (fetch && state == State::downloading)
+        fetch->cancelled = true;
+    if (tracked)
+    {
+        map->resources.statesCounts[(uint32)(State)state]--;
+        map->resources.ramMemoryUse -= ramMemoryAccounted;
+        map->resources.gpuMemoryUse -= gpuMemoryAccounted;
+    }
     if (info.userData)
     {
         //assert(!map->resources.queUpload.stopped());
@@ -33,6 +33,7 @@
 #include "../tilesetMapping.hpp"
 #include "../geodata.hpp"
 #include "../renderTasks.hpp"
+#include "../hashTileId.hpp"
 
 namespace vts
 {
@@ -49,6 +50,7 @@ std::shared_ptr<T> getMapResource(MapImpl *map, const std::string &name)
     {
         auto r = std::make_shared<T>(map, name);
         it = map->resources.resources.insert(std::make_pair(name, r)).first;
+        map->resourceTrack(r);
         map->statistics.resourcesCreated++;
     }
     assert(it->second);
@@ -58,11 +60,134 @@ std::shared_ptr<T> getMapResource(MapImpl *map, const std::string &name)
     return res;
 }
 
+enum class ReadAhead
+{
+    None,
+    Children, // four metatiles at the next lod
+    Siblings, // the other three children of the same parent
+};
+
+void readAheadNames(MapImpl *map, const UrlTemplate &urlTemplate,
+    const UrlTemplate::Vars &vars, ReadAhead readAhead,
+    std::vector<std::string> &names)
+{
+    switch (readAhead)
+    {
+    case ReadAhead::None:
+        break;
+    case ReadAhead::Children:
+    {
+        if (!map->mapconfig)
+            break;
+        uint32 s = 1 << map->mapconfig->referenceFrame.metaBinaryOrder;
+        for (uint32 i = 0; i < 4; i++)
+        {
+            UrlTemplate::Vars v(vars);
+            v.tileId.lod++;
+            v.tileId.x = vars.tileId.x * 2 + (i % 2) * s;
+            v.tileId.y = vars.tileId.y * 2 + (i / 2) * s;
+            v.localId.lod++;
+            v.localId.x = vars.localId.x * 2 + (i % 2) * s;
+            v.localId.y = vars.localId.y * 2 + (i / 2) * s;
+            names.push_back(urlTemplate(v));
+        }
+    } break;
+    case ReadAhead::Siblings:
+    {
+        if (vars.tileId.lod == 0)
+            break;
+        for (uint32 i = 0; i < 4; i++)
+        {
+            UrlTemplate::Vars v(vars);
+            v.tileId.x = (vars.tileId.x & ~1u) + i % 2;
+            v.tileId.y = (vars.tileId.y & ~1u) + i / 2;
+            if (v.tileId == vars.tileId)
+                continue;
+            // the local id is offset by the same amount
+            v.localId.x += v.tileId.x - vars.tileId.x;
+            v.localId.y += v.tileId.y - vars.tileId.y;
+            names.push_back(urlTemplate(v));
+        }
+    } break;
+    }
+}
+
+template<class T>
+std::shared_ptr<T> getMapResource(MapImpl *map,
+    const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars,
+    ReadAhead readAhead = ReadAhead::None)
+{
+    std::weak_ptr<Resource> &w = map->resources.resourcesByKey[
+        ResourceKey(&urlTemplate, vars)];
+    std::shared_ptr<Resource> r = w.lock();
+    if (r)
+    {
+        map->touchResource(r);
+        // the same template always generates the same type of resources
+        assert(std::dynamic_pointer_cast<T>(r));
+        assert(r->name == urlTemplate(vars));
+        return std::static_pointer_cast<T>(r);
+    }
+    const std::string name = urlTemplate(vars);
+    const bool created = map->resources.resources.count(name) == 0;
+    auto res = getMapResource<T>(map, name);
+    w = res;
+    if (created && map->createOptions.diskCache
+        && map->createOptions.cacheReadAhead)
+    {
+        // the resource is not visible to other threads yet
+        readAheadNames(map, urlTemplate, vars, readAhead, res->readAhead);
+    }
+    return res;
+}
+
 } // namespace
 
+ResourceKey::ResourceKey(const UrlTemplate *urlTemplate,
+    const UrlTemplate::Vars &vars) :
+    urlTemplate(urlTemplate), tileId(vars.tileId),
+    localId(vars.localId), subMesh(vars.subMesh),
+    srs(vars.srs), rf(vars.rf), params(vars.params)
+{}
+
+bool ResourceKey::operator == (const ResourceKey &other) const
+{
+    return urlTemplate == other.urlTemplate
+        && tileId == other.tileId
+        && localId == other.localId
+        && subMesh == other.subMesh
+        && srs == other.srs
+        && rf == other.rf
+        && params == other.params;
+}
+
+std::size_t ResourceKeyHash::operator()(const ResourceKey &key) const
+{
+    std::size_t r = std::hash<const void*>()(key.urlTemplate);
+    r = r * 31 + std::hash<TileId>()(key.tileId);
+    r = r * 31 + std::hash<TileId>()(key.localId);
+    r = r * 31 + key.subMesh;
+    // the strings are usually empty
+    if (!key.srs.empty())
+        r = r * 31 + std::hash<std::string>()(key.srs);
+    if (!key.rf.empty())
+        r = r * 31 + std::hash<std::string>()(key.rf);
+    for (const std::string &p : key.params)
+        r = r * 31 + std::hash<std::string>()(p);
+    return r;
+}
+
 void MapImpl::touchResource(const std::shared_ptr<Resource> &resource)
 {
+    if (resource->lastAccessTick == renderTickIndex)
+        return;
     resource->lastAccessTick = renderTickIndex;
+    if (resource->tracked)
+    {
+        // move to the most recently used end
+        resources.lru.splice(resources.lru.end(), resources.lru,
+            resource->lruPosition);
+    }
 }
 
 Validity MapImpl::getResourceValidity(const std::string &name)
@@ -93,6 +218,16 @@ std::shared_ptr<GpuTexture> MapImpl::getTexture(const std::string &name)
     return getMapResource<GpuTexture>(this, name);
 }
 
+std::shared_ptr<GpuTexture> MapImpl::getTexture(
+    const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars)
+{
+    // tile textures are photographic, unlike the icons and fonts
+    auto r = getMapResource<GpuTexture>(this, urlTemplate, vars,
+        ReadAhead::Siblings);
+    r->compressible = true;
+    return r;
+}
+
 std::shared_ptr<GpuAtmosphereDensityTexture>
 MapImpl::getAtmosphereDensityTexture(
     const std::string &name)
@@ -120,12 +255,25 @@ std::shared_ptr<MetaTile> MapImpl::getMetaTile(const std::string &name)
     return getMapResource<MetaTile>(this, name);
 }
 
+std::shared_ptr<MetaTile> MapImpl::getMetaTile(
+    const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars)
+{
+    return getMapResource<MetaTile>(this, urlTemplate, vars,
+        ReadAhead::Children);
+}
+
 std::shared_ptr<MeshAggregate> MapImpl::getMeshAggregate(
         const std::string &name)
 {
     return getMapResource<MeshAggregate>(this, name);
 }
 
+std::shared_ptr<MeshAggregate> MapImpl::getMeshAggregate(
+    const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars)
+{
+    return getMapResource<MeshAggregate>(this, urlTemplate, vars);
+}
+
 std::shared_ptr<ExternalBoundLayer> MapImpl::getExternalBoundLayer(
         const std::string &name)
 {
@@ -144,6 +292,12 @@ std::shared_ptr<BoundMetaTile> MapImpl::getBoundMetaTile(
     return getMapResource<BoundMetaTile>(this, name);
 }
 
+std::shared_ptr<BoundMetaTile> MapImpl::getBoundMetaTile(
+    const UrlTemplate &urlTemplate, const UrlTemplate::Vars &vars)
+{
+    return getMapResource<BoundMetaTile>(this, urlTemplate, vars);
+}
+
 std::shared_ptr<SearchTaskImpl> MapImpl::getSearchTask(const std::string &name)
 {
     return getMapResource<SearchTaskImpl>(this, name);
@@ -34,6 +34,105 @@
 namespace vts
 {
 
+namespace
+{
+
+// compatible with OpenGL
+enum CompressedFormat
+{
+    CompressedRgbS3tcDxt1 = 0x83F0,
+    CompressedRgbaS3tcDxt5 = 0x83F3,
+    CompressedRgb8Etc2 = 0x9274,
+    CompressedRgba8Etc2Eac = 0x9278,
+};
+
+uint32 compressedBlockSize(uint32 internalFormat)
+{
+    switch (internalFormat)
+    {
+    case CompressedRgbS3tcDxt1:
+    case CompressedRgb8Etc2:
+        return 8;
+    case CompressedRgbaS3tcDxt5:
+    case CompressedRgba8Etc2Eac:
+        return 16;
+    default:
+        return 0;
+    }
+}
+
+bool filterUsesMipmaps(GpuTextureSpec::FilterMode filterMode)
+{
+    switch (filterMode)
+    {
+    case GpuTextureSpec::FilterMode::Nearest:
+    case GpuTextureSpec::FilterMode::Linear:
+        return false;
+    default:
+        return true;
+    }
+}
+
+void compressLevel(GpuTextureSpec &spec, TextureCompression compression,
+    Buffer &level, uint32 width, uint32 height)
+{
+    Buffer out;
+    switch (compression)
+    {
+    case TextureCompression::Bc:
+        encodeBc(level, out, width, height, spec.components);
+        break;
+    case TextureCompression::Etc2:
+        encodeEtc2(level, out, width, height, spec.components);
+        break;
+    default:
+        LOGTHROW(fatal, std::logic_error) << "Invalid texture compression";
+    }
+    level = std::move(out);
+}
+
+// generate the mipmaps and compress all levels
+void transcodeTexture(GpuTextureSpec &spec, bool mipmaps,
+    TextureCompression compression)
+{
+    if (spec.type != GpuTypeEnum::UnsignedByte)
+        return;
+    if (compression != TextureCompression::None
+        && spec.components != 3 && spec.components != 4)
+        compression = TextureCompression::None;
+    if (mipmaps)
+    {
+        uint32 w = spec.width, h = spec.height;
+        const Buffer *prev = &spec.buffer;
+        while (w > 1 || h > 1)
+        {
+            Buffer next;
+            downsampleImage(*prev, next, w, h, spec.components);
+            w = std::max(w / 2, 1u);
+            h = std::max(h / 2, 1u);
+            spec.mipmaps.push_back(std::move(next));
+            prev = &spec.mipmaps.back();
+        }
+    }
+    if (compression == TextureCompression::None)
+        return;
+    compressLevel(spec, compression, spec.buffer, spec.width, spec.height);
+    for (uint32 i = 0, e = spec.mipmaps.size(); i < e; i++)
+    {
+        compressLevel(spec, compression, spec.mipmaps[i],
+            std::max(spec.width >> (i + 1), 1u),
+            std::max(spec.height >> (i + 1), 1u));
+    }
+    if (compression == TextureCompression::Bc)
+        spec.internalFormat = spec.components == 4
+            ? CompressedRgbaS3tcDxt5 : CompressedRgbS3tcDxt1;
+    else
+        spec.internalFormat = spec.components == 4
+            ? CompressedRgba8Etc2Eac : CompressedRgb8Etc2;
+}
+
+} // namespace
+
 GpuTextureSpec::GpuTextureSpec(const Buffer &buffer)
 {
     decodeImage(buffer, this->buffer, width, height, components);
@@ -54,14 +153,24 @@ void GpuTextureSpec::verticalFlip()
     }
 }
 
-uint32 GpuTextureSpec::expectedSize() const
+uint32 GpuTextureSpec::expectedSize(uint32 level) const
 {
-    return width * height * components * gpuTypeSize(type);
+    uint32 w = std::max(width >> level, 1u);
+    uint32 h = std::max(height >> level, 1u);
+    uint32 bs = compressedBlockSize(internalFormat);
+    if (bs)
+        return ((w + 3) / 4) * ((h + 3) / 4) * bs;
+    return w * h * components * gpuTypeSize(type);
+}
+
+bool GpuTextureSpec::compressed() const
+{
+    return compressedBlockSize(internalFormat) > 0;
 }
 
 Buffer GpuTextureSpec::encodePng() const
 {
-    if (type != GpuTypeEnum::UnsignedByte)
+    if (type != GpuTypeEnum::UnsignedByte || compressed())
     {
         LOGTHROW(err2, std::runtime_error) << "Unsigned byte is the only "
                                     "supported image type for png encode.";
@@ -78,8 +187,16 @@ GpuTexture::GpuTexture(MapImpl *map, const std::string &name) :
 void GpuTexture::decode()
 {
     LOG(info1) << "Decoding texture <" << name << ">";
-    std::shared_ptr<GpuTextureSpec> spec
-        = std::make_shared<GpuTextureSpec>(fetch->reply.content);
+    std::shared_ptr<GpuTextureSpec> spec = std::make_shared<GpuTextureSpec>();
+    {
+        // decode the rows bottom-up, as expected by the renderers
+        ImageDecodeOptions opts;
+        opts.components = map->createOptions.textureComponents;
+        opts.minResolution = downscaleLimit;
+        opts.bottomUp = true;
+        decodeImage(fetch->reply.content, spec->buffer,
+            spec->width, spec->height, spec->components, opts);
+    }
     this->width = spec->width;
     this->height = spec->height;
     spec->filterMode = filterMode;
@@ -96,15 +213,31 @@ void GpuTexture::decode()
         if (!boost::filesystem::exists(path))
         {
             boost::filesystem::create_directories(prefix + b);
-            Buffer out;
-            encodePng(spec->buffer, out,
-                spec->width, spec->height, spec->components);
-            writeLocalFileBuffer(path, out);
+            GpuTextureSpec topDown;
+            topDown.width = spec->width;
+            topDown.height = spec->height;
+            topDown.components = spec->components;
+            topDown.buffer = spec->buffer.copy();
+            topDown.verticalFlip();
+            writeLocalFileBuffer(path, topDown.encodePng());
         }
     }
 #endif
 
-    spec->verticalFlip();
+    {
+        const MapCreateOptions &o = map->createOptions;
+        bool transcode = o.textureMipmaps
+            || o.textureCompression != TextureCompression::None;
+        // tile textures are sampled with mipmaps
+        //   only when they are generated here, off the render thread
+        if (transcode && compressible
+            && spec->filterMode == GpuTextureSpec::FilterMode::Linear)
+            spec->filterMode = GpuTextureSpec::FilterMode::LinearMipmapLinear;
+        transcodeTexture(*spec,
+            transcode && filterUsesMipmaps(spec->filterMode),
+            compressible ? o.textureCompression : TextureCompression::None);
+    }
+
     decodeData = std::static_pointer_cast<void>(spec);
 }
 
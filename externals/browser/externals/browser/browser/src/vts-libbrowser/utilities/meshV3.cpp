@@ -0,0 +1,351 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#include "../include/vts-browser/math.hpp"
+#include "meshV3.hpp"
+
+#include <dbglog/dbglog.hpp>
+
+#include <cstring>
+
+namespace vts
+{
+
+namespace
+{
+
+// see SubMeshFlag in vts-libs meshio
+const uint8 FlagInternalTexture = 0x1;
+const uint8 FlagExternalTexture = 0x2;
+const uint8 FlagTextureMode = 0x8;
+
+class Reader
+{
+public:
+    explicit Reader(const Buffer &b) :
+        p((const unsigned char *)b.data()),
+        e((const unsigned char *)b.dataEnd())
+    {}
+
+    template<class T>
+    T read()
+    {
+        require(sizeof(T));
+        T v;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return v;
+    }
+
+    // variable length word, one or two bytes
+    uint32 word()
+    {
+        require(1);
+        uint32 b1 = *p++;
+        if (b1 & 0x80)
+        {
+            require(1);
+            return (b1 & 0x7f) | (uint32(*p++) << 7);
+        }
+        return b1;
+    }
+
+    // zigzag encoded difference from the previous value
+    int delta(int &last)
+    {
+        uint32 w = word();
+        return last += int((w >> 1) ^ (-(w & 1)));
+    }
+
+    // difference from the highest index so far, zero introduces a new one
+    uint32 index(int &high, uint32 count)
+    {
+        int delta = word();
+        int index = high - delta;
+        if (!delta)
+            high++;
+        if (index < 0 || uint32(index) >= count)
+        {
+            LOGTHROW(err2, std::runtime_error)
+                << "Mesh face index out of range";
+        }
+        return index;
+    }
+
+private:
+    void require(uint32 n)
+    {
+        if (uint32(e - p) < n)
+        {
+            LOGTHROW(err2, std::runtime_error)
+                << "Mesh data are truncated";
+        }
+    }
+
+    const unsigned char *p;
+    const unsigned char *const e;
+};
+
+// intermediate data reused by all meshes decoded in the thread
+struct Scratch
+{
+    std::vector<vec3si32> quantized;
+    std::vector<vec3f> positions;
+    std::vector<vec2ui16> externalUvs;
+    std::vector<uint32> faces;
+};
+
+thread_local Scratch scratch;
+
+void decodeSubmesh(Reader &r, MeshV3Part &part)
+{
+    Scratch &s = scratch;
+    GpuMeshSpec &spec = part.spec;
+
+    const uint8 flags = r.read<uint8>();
+    part.surfaceReference = r.read<uint8>();
+    const uint16 layer = r.read<uint16>();
+    if (flags & FlagTextureMode)
+        part.textureLayer = layer;
+
+    vec3 center, size;
+    {
+        double b[6];
+        for (double &it : b)
+            it = r.read<double>();
+        for (uint32 i = 0; i < 3; i++)
+        {
+            center[i] = 0.5 * (b[i] + b[i + 3]);
+            size[i] = b[i + 3] - b[i];
+        }
+    }
+    const double scale = std::max(size[0], std::max(size[1], size[2]));
+
+    // positions
+    const uint32 vertexCount = r.read<uint16>();
+    {
+        const double multiplier = 1.0 / r.read<uint16>();
+        s.quantized.resize(vertexCount);
+        vec3si32 qmin = vec3si32::Constant(
+            std::numeric_limits<sint32>::max());
+        vec3si32 qmax = vec3si32::Constant(
+            std::numeric_limits<sint32>::min());
+        int last[3] = { 0, 0, 0 };
+        for (vec3si32 &q : s.quantized)
+        {
+            for (uint32 i = 0; i < 3; i++)
+                q[i] = r.delta(last[i]);
+            qmin = qmin.cwiseMin(q);
+            qmax = qmax.cwiseMax(q);
+        }
+
+        // the same arithmetic as in loadMeshProperNormalized
+        //   to obtain bit-identical results
+        const auto &denorm = [&](sint32 q, uint32 i) -> double
+        {
+            return double(q) * multiplier * scale + center[i];
+        };
+        part.extents = math::Extents3(math::InvalidExtents{});
+        if (vertexCount)
+        {
+            for (uint32 i = 0; i < 3; i++)
+            {
+                part.extents.ll[i] = denorm(qmin[i], i);
+                part.extents.ur[i] = denorm(qmax[i], i);
+            }
+        }
+        const math::Point3 ec = math::center(part.extents);
+        const auto es = math::size(part.extents);
+        const vec3 norm(2.0 / es.width, 2.0 / es.height, 2.0 / es.depth);
+        s.positions.resize(vertexCount);
+        for (uint32 v = 0; v < vertexCount; v++)
+        {
+            for (uint32 i = 0; i < 3; i++)
+            {
+                s.positions[v][i] = float(
+                    (denorm(s.quantized[v][i], i) - ec[i]) * norm[i]);
+            }
+        }
+    }
+
+    // external uv
+    const bool externalUv = (flags & FlagExternalTexture) && vertexCount;
+    if (flags & FlagExternalTexture)
+    {
+        const double multiplier = 1.0 / r.read<uint16>();
+        s.externalUvs.resize(vertexCount);
+        int last[2] = { 0, 0 };
+        for (vec2ui16 &uv : s.externalUvs)
+        {
+            vec2f f;
+            for (uint32 i = 0; i < 2; i++)
+                f[i] = float(double(r.delta(last[i])) * multiplier);
+            uv = vec2to2ui16(f);
+        }
+    }
+
+    // internal uv, written directly to the output vertices
+    uint32 tcCount = 0;
+    uint32 vertexSize = 0;
+    if (flags & FlagInternalTexture)
+    {
+        tcCount = r.read<uint16>();
+        double multiplier[2];
+        multiplier[0] = 1.0 / r.read<uint16>();
+        multiplier[1] = 1.0 / r.read<uint16>();
+        if (tcCount)
+        {
+            vertexSize = surfaceMeshLayout(spec, true, externalUv);
+            spec.verticesCount = tcCount;
+            spec.vertices.allocate(tcCount * vertexSize);
+        }
+        char *o = spec.vertices.data() + spec.attributes[1].offset;
+        int last[2] = { 0, 0 };
+        for (uint32 t = 0; t < tcCount; t++)
+        {
+            vec2f f;
+            for (uint32 i = 0; i < 2; i++)
+                f[i] = float(double(r.delta(last[i])) * multiplier[i]);
+            *(vec2ui16*)o = vec2to2ui16(f);
+            o += vertexSize;
+        }
+    }
+
+    // faces
+    const uint32 faceCount = r.read<uint16>();
+    s.faces.resize(faceCount * 3);
+    {
+        int high = 0;
+        for (uint32 &it : s.faces)
+            it = r.index(high, vertexCount);
+    }
+
+    spec.indicesCount = faceCount * 3;
+    spec.indices.allocate(spec.indicesCount * sizeof(uint16));
+    uint16 *io = (uint16*)spec.indices.data();
+
+    if (tcCount)
+    {
+        // internal control
+        //   the vertices are indexed by the internal uv
+        char *ps = spec.vertices.data() + spec.attributes[0].offset;
+        char *es = spec.vertices.data() + spec.attributes[2].offset;
+        int high = 0;
+        for (uint32 fi = 0, fe = faceCount * 3; fi != fe; fi++)
+        {
+            const uint32 oi = r.index(high, tcCount);
+            const uint32 ii = s.faces[fi];
+            *io++ = oi;
+            *(vec3f*)(ps + oi * vertexSize) = s.positions[ii];
+            if (externalUv)
+                *(vec2ui16*)(es + oi * vertexSize) = s.externalUvs[ii];
+        }
+        return;
+    }
+
+    // skip internal uv faces that have no uv
+    if (flags & FlagInternalTexture)
+    {
+        for (uint32 i = 0, e = faceCount * 3; i != e; i++)
+            r.word();
+    }
+
+    // external control
+    vertexSize = surfaceMeshLayout(spec, false, externalUv);
+    spec.verticesCount = vertexCount;
+    spec.vertices.allocate(vertexCount * vertexSize);
+    for (uint32 it : s.faces)
+        *io++ = it;
+    char *ps = spec.vertices.data() + spec.attributes[0].offset;
+    for (uint32 v = 0; v < vertexCount; v++)
+        *(vec3f*)(ps + v * vertexSize) = s.positions[v];
+    if (externalUv)
+    {
+        char *es = spec.vertices.data() + spec.attributes[2].offset;
+        for (uint32 v = 0; v < vertexCount; v++)
+            *(vec2ui16*)(es + v * vertexSize) = s.externalUvs[v];
+    }
+}
+
+} // namespace
+
+uint32 surfaceMeshLayout(GpuMeshSpec &spec, bool internalUv, bool externalUv)
+{
+    uint32 offset = 0;
+
+    { // positions
+        spec.attributes[0].enable = true;
+        spec.attributes[0].components = 3;
+        spec.attributes[0].offset = offset;
+        offset += sizeof(vec3f);
+    }
+
+    if (internalUv)
+    { // internal uv
+        spec.attributes[1].enable = true;
+        spec.attributes[1].type = GpuTypeEnum::UnsignedShort;
+        spec.attributes[1].components = 2;
+        spec.attributes[1].normalized = true;
+        spec.attributes[1].offset = offset;
+        offset += sizeof(vec2ui16);
+    }
+
+    if (externalUv)
+    { // external uv
+        spec.attributes[2].enable = true;
+        spec.attributes[2].type = GpuTypeEnum::UnsignedShort;
+        spec.attributes[2].components = 2;
+        spec.attributes[2].normalized = true;
+        spec.attributes[2].offset = offset;
+        offset += sizeof(vec2ui16);
+    }
+
+    for (uint32 i = 0; i < 3; i++)
+    {
+        if (spec.attributes[i].enable)
+            spec.attributes[i].stride = offset;
+    }
+    return offset;
+}
+
+bool decodeMeshV3(const Buffer &in, std::vector<MeshV3Part> &out)
+{
+    out.clear();
+    Reader r(in);
+    if (in.size() < 4 || in.data()[0] != 'M' || in.data()[1] != 'E')
+        return false; // eg. gzipped
+    r.read<uint16>(); // magic
+    if (r.read<uint16>() != 3)
+        return false;
+    r.read<double>(); // mean undulation, ignored
+    out.resize(r.read<uint16>());
+    for (MeshV3Part &it : out)
+        decodeSubmesh(r, it);
+    return true;
+}
+
+} // namespace vts
@@ -0,0 +1,65 @@
+/**
+ * Copyright (c) 2017 Melown Technologies SE
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * *  Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *
+ * *  Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ */
+
+
+#ifndef MESHV3_HPP_k3v9xq2pw7
+#define MESHV3_HPP_k3v9xq2pw7
+
+#include "../include/vts-browser/resources.hpp"
+
+#include <math/geometry_core.hpp>
+
+#include <vector>
+
+namespace vts
+{
+
+// memory layout of surface meshes:
+//   float positions, optionally followed by normalized uint16 internal uv
+//   and normalized uint16 external uv
+// returns the vertex size
+uint32 surfaceMeshLayout(GpuMeshSpec &spec, bool internalUv, bool externalUv);
+
+// submesh decoded straight into the surface mesh layout
+struct MeshV3Part
+{
+    GpuMeshSpec spec;
+    math::Extents3 extents; // the positions are normalized to these
+    uint32 textureLayer = 0;
+    uint32 surfaceReference = 0;
+};
+
+// decodes vts mesh version 3 in a single pass over the buffer
+//   without the intermediate vtslibs submeshes
+// the result is identical to loadMeshProperNormalized followed
+//   by conversion to the surface mesh layout
+// returns false if the buffer is not an uncompressed mesh of version 3
+//   (use the generic decoder then)
+bool decodeMeshV3(const Buffer &in, std::vector<MeshV3Part> &out);
+
+} // namespace vts
+
+#endif
@@ -28,6 +28,8 @@
 #define THREAD_QUEUE_gdf5g4d56f4ghd6h4
 
 #include <vector>
+#include <algorithm>
+#include <limits>
 #include <atomic>
 #include <thread>
 #include <mutex>
@@ -87,9 +89,8 @@ public:
     std::vector<T> readAllWait()
     {
         std::unique_lock<std::mutex> lock(mut);
-        if (stop)
-            return {};
-        con.wait(lock);
+        while (q.empty() && !stop)
+            con.wait(lock);
         if (stop)
             return {};
         std::vector<T> res;
@@ -144,6 +145,207 @@ private:
     std::condition_variable con;
 };
 
+// queue ordered by priority of the items (highest priority first)
+// the priority of each item is obtained by calling:
+//   bool threadQueuePriority(const T &v, float &priority);
+// which returns false for stale items, these are dropped
+// the priority is reevaluated when the item is being popped,
+//   and the item is reinserted if its priority has decreased
+// items whose priority has increased are moved forward
+//   only by calling reprioritize
+// items with equal priority are popped in the order of insertion
+template<class T>
+class ThreadPriorityQueue
+{
+public:
+    void push(const T &v)
+    {
+        T c(v);
+        push(std::move(c));
+    }
+
+    void push(T &&v)
+    {
+        Item it;
+        if (!threadQueuePriority(v, it.priority))
+            return;
+        it.value = std::move(v);
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            if (stop)
+                return;
+            insert(std::move(it));
+        }
+        con.notify_one();
+    }
+
+    bool tryPop(T &v)
+    {
+        while (true)
+        {
+            Item it;
+            float next;
+            {
+                std::lock_guard<std::mutex> lock(mut);
+                if (q.empty() || stop)
+                    return false;
+                extract(it, next);
+            }
+            // the priority is evaluated outside of the lock
+            //   because it may release the last reference to a resource
+            if (evaluate(it, next))
+            {
+                v = std::move(it.value);
+                return true;
+            }
+        }
+    }
+
+    bool waitPop(T &v)
+    {
+        while (true)
+        {
+            Item it;
+            float next;
+            {
+                std::unique_lock<std::mutex> lock(mut);
+                while (q.empty() && !stop)
+                    con.wait(lock);
+                if (q.empty() || stop)
+                    return false;
+                extract(it, next);
+            }
+            if (evaluate(it, next))
+            {
+                v = std::move(it.value);
+                return true;
+            }
+        }
+    }
+
+    // reevaluates the priorities of all items and rebuilds the heap
+    //   stale items are dropped
+    // the queue appears empty to other threads in the meantime
+    void reprioritize()
+    {
+        std::vector<Item> tmp;
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            if (stop)
+                return;
+            tmp.swap(q);
+        }
+        if (tmp.empty())
+            return;
+        // the priorities are evaluated outside of the lock
+        //   because it may release the last reference to a resource
+        std::vector<Item> items;
+        items.reserve(tmp.size());
+        for (Item &it : tmp)
+        {
+            if (threadQueuePriority(it.value, it.priority))
+                items.push_back(std::move(it));
+        }
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            if (stop)
+                return;
+            // keep items inserted meanwhile
+            for (Item &it : q)
+                items.push_back(std::move(it));
+            q.swap(items);
+            std::make_heap(q.begin(), q.end());
+        }
+        con.notify_all();
+    }
+
+    void terminate()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            stop = true;
+        }
+        con.notify_all();
+    }
+
+    void purge()
+    {
+        std::vector<Item> tmp;
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            stop = true;
+            tmp.swap(q);
+        }
+        con.notify_all();
+    }
+
+    bool stopped() const
+    {
+        return stop;
+    }
+
+    uint32 estimateSize() const
+    {
+        return q.size();
+    }
+
+private:
+    struct Item
+    {
+        T value;
+        float priority = 0;
+        uint64 order = 0;
+
+        bool operator < (const Item &other) const
+        {
+            if (priority != other.priority)
+                return priority < other.priority;
+            return order > other.order;
+        }
+    };
+
+    void insert(Item &&it)
+    {
+        it.order = counter++;
+        q.push_back(std::move(it));
+        std::push_heap(q.begin(), q.end());
+    }
+
+    void extract(Item &it, float &next)
+    {
+        std::pop_heap(q.begin(), q.end());
+        it = std::move(q.back());
+        q.pop_back();
+        next = q.empty() ? -std::numeric_limits<float>::infinity()
+            : q.front().priority;
+    }
+
+    // returns true if the item should be returned to the caller
+    bool evaluate(Item &it, float next)
+    {
+        float p;
+        if (!threadQueuePriority(it.value, p))
+            return false; // stale item
+        if (p >= it.priority || p >= next)
+            return true;
+        // the item is no longer the most important one
+        it.priority = p;
+        {
+            std::lock_guard<std::mutex> lock(mut);
+            if (stop)
+                return false;
+            insert(std::move(it));
+        }
+        return false;
+    }
+
+    std::atomic<bool> stop {false};
+    std::vector<Item> q; // binary heap
+    uint64 counter = 0;
+    mutable std::mutex mut;
+    std::condition_variable con;
+};
+
 } // namespace vts
 
 #endif
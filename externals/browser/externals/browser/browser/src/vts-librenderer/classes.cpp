@@ -448,16 +448,31 @@ bool gpuTypeInteger(GpuTypeEnum type)
 void Texture::load(ResourceInfo &info, vts::GpuTextureSpec &spec,
     const std::string &debugId)
 {
-    assert(spec.buffer.size() == spec.width * spec.height
-           * spec.components * gpuTypeSize(spec.type)
+    assert(spec.buffer.size() == spec.expectedSize()
            || spec.buffer.size() == 0);
 
     clear();
     glGenTextures(1, &id);
     glBindTexture(GL_TEXTURE_2D, id);
-    glTexImage2D(GL_TEXTURE_2D, 0, findInternalFormat(spec),
-                 spec.width, spec.height, 0,
-                 findFormat(spec), (GLenum)spec.type, spec.buffer.data());
+    uint32 gpuMemory = 0;
+    for (uint32 level = 0; level <= spec.mipmaps.size(); level++)
+    {
+        const Buffer &buf = level ? spec.mipmaps[level - 1] : spec.buffer;
+        uint32 w = std::max(spec.width >> level, 1u);
+        uint32 h = std::max(spec.height >> level, 1u);
+        if (spec.compressed())
+        {
+            glCompressedTexImage2D(GL_TEXTURE_2D, level, spec.internalFormat,
+                                   w, h, 0, buf.size(), buf.data());
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, findInternalFormat(spec),
+                         w, h, 0, findFormat(spec), (GLenum)spec.type,
+                         buf.data());
+        }
+        gpuMemory += buf.size();
+    }
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
         (GLenum)spec.filterMode);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
@@ -474,21 +489,30 @@ void Texture::load(ResourceInfo &info, vts::GpuTextureSpec &spec,
                         maxAnisotropySamples);
     }
 
-    switch (spec.filterMode)
+    if (!spec.mipmaps.empty())
     {
-    case GpuTextureSpec::FilterMode::Nearest:
-    case GpuTextureSpec::FilterMode::Linear:
-        break;
-    default:
-        glGenerateMipmap(GL_TEXTURE_2D);
-        break;
+        // the mipmaps were generated when decoding
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL,
+                        spec.mipmaps.size());
+    }
+    else if (!spec.compressed())
+    {
+        switch (spec.filterMode)
+        {
+        case GpuTextureSpec::FilterMode::Nearest:
+        case GpuTextureSpec::FilterMode::Linear:
+            break;
+        default:
+            glGenerateMipmap(GL_TEXTURE_2D);
+            break;
+        }
     }
 
     grayscale = spec.components == 1;
     setDebugId(debugId);
     CHECK_GL("load texture");
     info.ramMemoryCost += sizeof(*this);
-    info.gpuMemoryCost += spec.buffer.size();
+    info.gpuMemoryCost += gpuMemory;
 }
 
 void Texture::setId(uint32 id)
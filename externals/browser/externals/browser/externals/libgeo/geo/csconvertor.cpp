@@ -48,6 +48,18 @@ public:
 
     virtual math::Point2 convert(const math::Point2 &p) const = 0;
     virtual math::Point3 convert(const math::Point3 &p) const = 0;
+
+    /** Converts points in place, one by one by default.
+     */
+    virtual void convert(double *points, std::size_t count
+                         , std::size_t stride) const
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            double *p(points + i * stride);
+            const auto r(convert(math::Point3(p[0], p[1], p[2])));
+            p[0] = r[0]; p[1] = r[1]; p[2] = r[2];
+        }
+    }
     virtual bool isProjected() const { return true; }
     virtual bool areSrsEqual() const = 0;
 
@@ -59,6 +71,7 @@ class NoOpConvertor : public CsConvertor::Impl
 public:
     virtual math::Point2 convert(const math::Point2 &p) const { return p; }
     virtual math::Point3 convert(const math::Point3 &p) const { return p; }
+    virtual void convert(double*, std::size_t, std::size_t) const {}
     virtual bool isProjected() const { return false; }
     virtual bool areSrsEqual() const { return true; }
     virtual pointer inverse() const {
@@ -513,6 +526,12 @@ math::Point3 CsConvertor::operator()(const math::Point3 &p) const
     return trans_->convert(p);
 }
 
+void CsConvertor::operator()(double *points, std::size_t count
+                             , std::size_t stride) const
+{
+    trans_->convert(points, count, stride);
+}
+
 math::Point4 CsConvertor::operator()(const math::Point4 &p) const
 {
     const auto pp(trans_->convert
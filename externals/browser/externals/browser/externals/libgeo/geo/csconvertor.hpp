@@ -73,6 +73,14 @@ public:
     math::Points2 operator()(const math::Points2 &p) const;
     math::Points3 operator()(const math::Points3 &p) const;
 
+    /** Converts count 3D points in place, all of them at once.
+     *  The i-th point is at points[i * stride] (x, y and z follow).
+     *  Cheaper than converting the points one by one when the underlying
+     *  transformation supports it.
+     */
+    void operator()(double *points, std::size_t count
+                    , std::size_t stride = 3) const;
+
     /** Homogeneous point support.
      */
     math::Point4 operator()(const math::Point4 &p) const;
@@ -44,6 +44,18 @@ public:
     virtual ~Impl() {}
     virtual math::Point2 convert(const math::Point2 &p) const = 0;
     virtual math::Point3 convert(const math::Point3 &p) const = 0;
+
+    /** Converts points in place, one by one by default.
+     */
+    virtual void convert(double *points, std::size_t count
+                         , std::size_t stride) const
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            double *p(points + i * stride);
+            const auto r(convert(math::Point3(p[0], p[1], p[2])));
+            p[0] = r[0]; p[1] = r[1]; p[2] = r[2];
+        }
+    }
 };
 
 namespace {
@@ -58,6 +70,7 @@ public:
 
     virtual math::Point2 convert(const math::Point2 &p) const { return p; }
     virtual math::Point3 convert(const math::Point3 &p) const { return p; }
+    virtual void convert(double*, std::size_t, std::size_t) const {}
 };
 
 class ProjInst
@@ -142,6 +155,53 @@ public:
         return r;
     }
 
+    virtual void convert(double *points, std::size_t count
+                         , std::size_t stride) const {
+        if (!count)
+            return;
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double *p(points + i * stride);
+            assert(!std::isnan(p[0]) && !std::isnan(p[1])
+                   && !std::isnan(p[2]));
+            p[0] *= preMult;
+            p[1] *= preMult;
+        }
+        auto err = pj_transform(from->pj, to->pj, count, stride
+                                , points, points + 1, points + 2);
+        if (err == -38)
+        {
+            if (gridNotFoundReported)
+            {
+                throw std::runtime_error(
+                        "Error in coordinate transformation <-38>:"
+                        "<failed to load datum shift file>");
+            }
+            gridNotFoundReported = true;
+        }
+        if (err != 0)
+        {
+            LOGTHROW(err2, std::runtime_error)
+                << "Error in coordinate transformation <"
+                << err << ">:<" << pj_strerrno(err) << ">, "
+                << count << " points";
+        }
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            double *p(points + i * stride);
+            // with multiple points, proj marks the points that failed
+            // with HUGE_VAL instead of returning an error
+            if (p[0] == HUGE_VAL)
+            {
+                LOGTHROW(err2, std::runtime_error)
+                    << "Error in coordinate transformation, point #"
+                    << i << " of " << count << " failed to convert";
+            }
+            p[0] *= postMult;
+            p[1] *= postMult;
+        }
+    }
+
     std::unique_ptr<ProjInst> from, to;
     double preMult, postMult;
     mutable bool gridNotFoundReported;
@@ -184,6 +244,12 @@ math::Point3 CsConvertor::operator()(const math::Point3 &p) const
     return trans_->convert(p);
 }
 
+void CsConvertor::operator()(double *points, std::size_t count
+                             , std::size_t stride) const
+{
+    trans_->convert(points, count, stride);
+}
+
 math::Point4 CsConvertor::operator()(const math::Point4 &p) const
 {
     const auto pp(trans_->convert
@@ -26,12 +26,15 @@
 #ifndef http_contentfetcher_hpp_included_
 #define http_contentfetcher_hpp_included_
 
+#include <atomic>
 #include <ctime>
 #include <string>
 #include <vector>
 #include <memory>
 #include <exception>
 
+#include "utility/resourcefetcher.hpp"
+
 #include "constants.hpp"
 #include "sink.hpp"
 
@@ -48,19 +51,26 @@ public:
             : maxHostConnections(0),
               maxTotalConections(0),
               maxCacheConections(0),
-              pipelining(0)
+              pipelining(0),
+              compression(false)
         {}
 
         unsigned long maxHostConnections;
         unsigned long maxTotalConections;
         unsigned long maxCacheConections;
         long pipelining;
+
+        /** Negotiate compressed transfer (Accept-Encoding) using all
+         *  encodings supported by CURL, the content is decompressed on
+         *  the client threads.
+         */
+        bool compression;
     };
 
     struct RequestOptions {
         RequestOptions()
             : followRedirects(true), lastModified(-1), reuse(true)
-            , timeout(-1), delay()
+            , timeout(-1), delay(), weight()
         {}
 
         bool followRedirects;
@@ -86,6 +96,20 @@ public:
          *  Zero means immediate action.
          */
         unsigned long delay;
+
+        /** HTTP/2 stream weight (1-256). Zero means the default weight.
+         */
+        unsigned int weight;
+
+        /** Request is aborted as soon as possible once the flag is set.
+         *  Empty pointer means the request cannot be aborted.
+         */
+        std::shared_ptr<const std::atomic<bool>> aborted;
+
+        /** Body is written into the output instead of being passed to the
+         *  sink (which receives empty content).
+         */
+        utility::ResourceFetcher::Output::pointer output;
     };
 
     void fetch(const std::string &location
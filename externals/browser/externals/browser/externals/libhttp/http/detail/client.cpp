@@ -28,6 +28,7 @@
 
 #include <boost/format.hpp>
 #include <boost/algorithm/string/predicate.hpp>
+#include <boost/algorithm/string/trim.hpp>
 #include <boost/chrono/duration.hpp>
 #include <boost/asio/steady_timer.hpp>
 
@@ -103,6 +104,9 @@ namespace http { namespace detail {
     CHECK_CURLM_STATUS(::curl_multi_setopt(multi_, name, value)    \
                        , "curl_multi_setopt")
 
+// larger announced bodies are not pre-allocated
+const std::size_t MaxReservedContentLength(256 * 1024 * 1024);
+
 ClientConnection* connFromEasy(CURL *easy)
 {
     ClientConnection *conn(nullptr);
@@ -116,20 +120,41 @@ extern "C" {
 std::size_t http_curlclient_write(void *ptr, std::size_t size
                                   , std::size_t nmemb, void *userp)
 {
+    auto *conn(static_cast<ClientConnection*>(userp));
+    // returning different count aborts the transfer
+    if (conn->aborted()) { return 0; }
     auto count(size * nmemb);
-    static_cast<ClientConnection*>(userp)
-        ->store(static_cast<char*>(ptr), count);
+    try {
+        conn->store(static_cast<char*>(ptr), count);
+    } catch (const std::exception &e) {
+        // exception must not propagate through CURL
+        LOG(err2) << "Failed to store received data: <" << e.what() << ">.";
+        return 0;
+    }
     return count;
 }
 
 std::size_t http_curlclient_header(char *buf, std::size_t size
                                    , std::size_t nmemb, void *userp)
 {
+    auto *conn(static_cast<ClientConnection*>(userp));
+    if (conn->aborted()) { return 0; }
     auto count(size * nmemb);
-    static_cast<ClientConnection*>(userp)->header(buf, count);
+    conn->header(buf, count);
     return count;
 }
 
+// called periodically even when no data are flowing
+#if LIBCURL_VERSION_NUM >= 0x072000 // 7.32.0
+int http_curlclient_progress(void *clientp, ::curl_off_t, ::curl_off_t
+                             , ::curl_off_t, ::curl_off_t)
+#else
+int http_curlclient_progress(void *clientp, double, double, double, double)
+#endif
+{
+    return static_cast<ClientConnection*>(clientp)->aborted() ? 1 : 0;
+}
+
 ::curl_socket_t http_curlclient_opensocket(void *clientp,
                                            ::curlsocktype purpose,
                                            ::curl_sockaddr *address)
@@ -153,6 +178,7 @@ ClientConnection
     , location_(location), sink_(sink)
     , maxAge_(constants::cacheUnspecified)
     , expires_(constants::cacheUnspecified)
+    , aborted_(options.aborted), output_(options.output)
 {
     LOG(info2) << "Starting transfer from <" << location_ << ">.";
 
@@ -189,6 +215,15 @@ ClientConnection
     SETOPT(CURLOPT_HTTP_VERSION, CURL_HTTP_VERSION_1_1);
 #endif
 
+    // negotiate compression, all supported encodings
+    if (owner.compression()) {
+#if LIBCURL_VERSION_NUM >= 0x071506 // 7.21.6
+        SETOPT(CURLOPT_ACCEPT_ENCODING, "");
+#else
+        SETOPT(CURLOPT_ENCODING, "");
+#endif
+    }
+
     // use user agent
     if (!options.userAgent.empty()) {
         SETOPT(CURLOPT_USERAGENT, options.userAgent.c_str());
@@ -223,6 +258,13 @@ ClientConnection
         SETOPT(CURLOPT_TIMEOUT_MS, long(options.timeout));
     }
 
+#if LIBCURL_VERSION_NUM >= 0x072E00 // 7.46.0
+    // share of the bandwidth of a multiplexed (HTTP/2) connection
+    if (options.weight > 0) {
+        SETOPT(CURLOPT_STREAM_WEIGHT, long(options.weight));
+    }
+#endif
+
     // set (optional) headers
     if (headers_) { SETOPT(CURLOPT_HTTPHEADER, headers_); }
 
@@ -236,6 +278,18 @@ ClientConnection
     SETOPT(CURLOPT_WRITEFUNCTION, &http_curlclient_write);
     SETOPT(CURLOPT_WRITEDATA, this);
 
+    // progress op, allows aborting stalled transfers
+    if (aborted_) {
+#if LIBCURL_VERSION_NUM >= 0x072000 // 7.32.0
+        SETOPT(CURLOPT_XFERINFOFUNCTION, &http_curlclient_progress);
+        SETOPT(CURLOPT_XFERINFODATA, this);
+#else
+        SETOPT(CURLOPT_PROGRESSFUNCTION, &http_curlclient_progress);
+        SETOPT(CURLOPT_PROGRESSDATA, this);
+#endif
+        SETOPT(CURLOPT_NOPROGRESS, 0L);
+    }
+
     // and finally set url
     SETOPT(CURLOPT_URL, location_.c_str());
 
@@ -256,6 +310,34 @@ ClientConnection::~ClientConnection()
 
 void ClientConnection::notify(::CURLcode result)
 {
+    if (aborted()) {
+        LOG(info2) << "Transfer from <" << location_ << "> aborted.";
+        sink_->error(std::make_error_code(std::errc::operation_canceled));
+        return;
+    }
+
+    if (output_) {
+        utility::ResourceFetcher::Output::Timings timings;
+        LOG_CURL_STATUS(::curl_easy_getinfo
+                        (easy_, CURLINFO_NAMELOOKUP_TIME
+                         , &timings.nameLookup)
+                        , "curl_easy_getinfo");
+        LOG_CURL_STATUS(::curl_easy_getinfo
+                        (easy_, CURLINFO_CONNECT_TIME, &timings.connect)
+                        , "curl_easy_getinfo");
+        LOG_CURL_STATUS(::curl_easy_getinfo
+                        (easy_, CURLINFO_APPCONNECT_TIME, &timings.tls)
+                        , "curl_easy_getinfo");
+        LOG_CURL_STATUS(::curl_easy_getinfo
+                        (easy_, CURLINFO_STARTTRANSFER_TIME
+                         , &timings.firstByte)
+                        , "curl_easy_getinfo");
+        LOG_CURL_STATUS(::curl_easy_getinfo
+                        (easy_, CURLINFO_TOTAL_TIME, &timings.total)
+                        , "curl_easy_getinfo");
+        output_->timings(timings);
+    }
+
     if (result != CURLE_OK) {
         sink_->error(utility::makeError<Error>
                      ("Transfer of <%s> failed: <%d, %s>."
@@ -287,17 +369,40 @@ void ClientConnection::notify(::CURLcode result)
                               (easy_, CURLINFO_CONTENT_TYPE, &contentType)
                               , "curl_easy_getinfo");
 
+            // size on the wire, before decompression
+            if (output_) {
+#if LIBCURL_VERSION_NUM >= 0x073700 // 7.55.0
+                ::curl_off_t transferred(0);
+                LOG_CURL_STATUS(::curl_easy_getinfo
+                                (easy_, CURLINFO_SIZE_DOWNLOAD_T
+                                 , &transferred)
+                                , "curl_easy_getinfo");
+#else
+                double transferred(0);
+                LOG_CURL_STATUS(::curl_easy_getinfo
+                                (easy_, CURLINFO_SIZE_DOWNLOAD
+                                 , &transferred)
+                                , "curl_easy_getinfo");
+#endif
+                output_->transferred(std::size_t(transferred));
+            }
+
             // expires header
             std::time_t expires(maxAge_);
             if (maxAge_ == constants::cacheUnspecified) {
                 expires = expires_;
             }
 
+            // validator for conditional requests
+            Header::list headers;
+            if (!etag_.empty()) { headers.emplace_back("ETag", etag_); }
+
             sink_->content(content_
                            , http::SinkBase::FileInfo
                            ((contentType ? contentType
                              : "application/octet-stream")
-                            , lastModified, long(expires)));
+                            , lastModified, long(expires))
+                           , &headers);
             break;
         }
 
@@ -411,6 +516,10 @@ void ClientConnection::notify(::CURLcode result)
 
 void ClientConnection::store(const char *data, std::size_t size)
 {
+    if (output_) {
+        output_->write(data, size);
+        return;
+    }
     content_.append(data, size);
 }
 
@@ -501,6 +610,21 @@ void ClientConnection::processHeader()
             // have no idea
             maxAge_ = constants::cacheUnspecified;
         }
+    } else if (ba::iequals(headerName_, "ETag")) {
+        etag_ = ba::trim_copy(headerValue_);
+    } else if (ba::iequals(headerName_, "Content-Length")) {
+        // pre-allocate the body (no exception, relaxed parsing)
+        std::istringstream is(headerValue_);
+        std::size_t length(0);
+        if ((is >> length) && (length <= MaxReservedContentLength)) {
+            try {
+                if (output_) {
+                    output_->reserve(length);
+                } else {
+                    content_.reserve(length);
+                }
+            } catch (const std::exception&) {}
+        }
     }
 
     headerName_.clear();
@@ -527,6 +651,7 @@ CurlClient::CurlClient(int id, const ContentFetcher::Options *options)
     , work_(std::ref(ios_))
     , timer_(ios_)
     , runningTransfers_()
+    , compression_(options && options->compression)
 {
     if (!multi_) {
         LOGTHROW(err2, Error)
@@ -642,6 +767,12 @@ void CurlClient::fetch(const std::string &location
         // immediate query
         ios_.post([=]() -> void
         {
+            if (options.aborted && *options.aborted) {
+                // aborted before it even started
+                sink->error(std::make_error_code
+                            (std::errc::operation_canceled));
+                return;
+            }
             try {
                 return add
                     (std::unique_ptr<ClientConnection>
@@ -78,6 +78,10 @@ public:
 
     void header(const char *data, std::size_t size);
 
+    /** Returns true when the requester has aborted the transfer.
+     */
+    bool aborted() const { return aborted_ && *aborted_; }
+
 private:
     void processHeader();
 
@@ -91,7 +95,11 @@ private:
 
     std::time_t maxAge_;
     std::time_t expires_;
+    std::string etag_;
     std::string content_;
+
+    std::shared_ptr<const std::atomic<bool>> aborted_;
+    utility::ResourceFetcher::Output::pointer output_;
 };
 
 struct Socket : boost::noncopyable {
@@ -176,6 +184,8 @@ public:
 
     int close_cb(::curl_socket_t s);
 
+    bool compression() const { return compression_; }
+
 private:
     void start(unsigned int id);
     void stop();
@@ -197,6 +207,7 @@ private:
     ClientConnection::set connections_;
     Socket::map sockets_;
     int runningTransfers_;
+    bool compression_;
 };
 
 } } // namespace http::detail
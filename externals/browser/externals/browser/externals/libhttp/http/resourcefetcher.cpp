@@ -136,6 +136,9 @@ public:
             options.reuse = query.reuse();
             options.timeout = query.timeout();
             options.delay = query.delay();
+            options.weight = query.weight();
+            options.aborted = query.abortFlag();
+            options.output = query.output();
             const auto &headers(query.options());
             options.headers.assign(headers.begin(), headers.end());
             return options;
@@ -165,14 +168,21 @@ private:
 
 void SingleQuerySink::content_impl(const void *data, std::size_t size
                                    , const FileInfo &stat, bool
-                                   , const Header::list*)
+                                   , const Header::list *headers)
 {
     // TODO: make better (use response Date field)
     std::time_t expires(-1);
     if (stat.cacheControl.maxAge && (*stat.cacheControl.maxAge >= 0)) {
         expires = std::time(nullptr) + *stat.cacheControl.maxAge;
     }
-    query->set(stat.lastModified, expires, data, size, stat.contentType);
+    std::string etag;
+    if (headers) {
+        for (const auto &header : *headers) {
+            if (header.name == "ETag") { etag = header.value; }
+        }
+    }
+    query->set(stat.lastModified, expires, data, size, stat.contentType
+               , etag);
     owner->ping();
 }
 
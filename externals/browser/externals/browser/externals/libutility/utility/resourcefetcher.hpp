@@ -27,6 +27,7 @@
 #ifndef utility_resourcefetcher_hpp_included_
 #define utility_resourcefetcher_hpp_included_
 
+#include <atomic>
 #include <cstdint>
 #include <ctime>
 #include <string>
@@ -48,6 +49,52 @@ class ResourceFetcher
 public:
     typedef std::shared_ptr<ResourceFetcher> pointer;
 
+    /** Receives body data directly from the transfer.
+     */
+    class Output {
+    public:
+        typedef std::shared_ptr<Output> pointer;
+
+        virtual ~Output() {}
+
+        /** Announced size of the body (e.g. Content-Length). It is a hint
+         *  only, actual amount of written data may differ.
+         */
+        virtual void reserve(std::size_t size) = 0;
+
+        /** Appends data to the body.
+         */
+        virtual void write(const char *data, std::size_t size) = 0;
+
+        /** Number of bytes received over the network, reported when the
+         *  transfer finishes. It differs from the size of the body when
+         *  the body was compressed for the transfer.
+         */
+        virtual void transferred(std::size_t size) { (void) size; }
+
+        /** Durations of the transfer, in seconds since its start.
+         *  Phases that did not happen (e.g. reused connection) are zero.
+         */
+        struct Timings {
+            double nameLookup;
+            double connect;
+            /** TLS handshake completed.
+             */
+            double tls;
+            /** Until the first byte of the response was received.
+             */
+            double firstByte;
+            double total;
+
+            Timings()
+                : nameLookup(), connect(), tls(), firstByte(), total() {}
+        };
+
+        /** Reported when the transfer finishes, regardless of the status.
+         */
+        virtual void timings(const Timings &timings) { (void) timings; }
+    };
+
     /** Query with a reply.
      */
     class Query : public utility::Supplement<Query> {
@@ -58,18 +105,23 @@ public:
             std::error_code redirect;
             std::string contentType;
             std::string data;
+            std::string etag;
 
             Body() : lastModified(-1), expires(-1), redirect() {}
         };
         typedef std::vector<std::pair<std::string, std::string>> Options;
 
+        /** Flag that aborts the query once set.
+         */
+        typedef std::shared_ptr<const std::atomic<bool>> AbortFlag;
+
         Query(Query&&) = default;
         Query& operator=(Query&&) = default;
         Query(const Query&) = default;
 
         Query()
             : empty_(true), followRedirects_(true), reuse_(true), timeout_(-1)
-            , delay_()
+            , delay_(), weight_()
         {}
 
         Query(const std::string &location, bool followRedirects = true);
@@ -100,6 +152,19 @@ public:
             delay_ = delay; return *this;
         }
 
+        /** HTTP/2 stream weight (1-256): share of the connection bandwidth
+         *  relative to other queries multiplexed on the same connection.
+         *  Zero means the default weight.
+         */
+        unsigned int weight() const { return weight_; }
+        /** HTTP/2 stream weight (1-256): share of the connection bandwidth
+         *  relative to other queries multiplexed on the same connection.
+         *  Zero means the default weight.
+         */
+        Query& weight(unsigned int weight) {
+            weight_ = weight; return *this;
+        }
+
         /** Add options. Option is protocol dependent. For HTTP, option =
          *  header.
          */
@@ -110,9 +175,32 @@ public:
 
         const Options& options() const { return options_; }
 
+        /** Query is aborted as soon as possible once the flag is set.
+         *  Aborted query fails with std::errc::operation_canceled.
+         */
+        const AbortFlag& abortFlag() const { return abortFlag_; }
+
+        /** Body data are written into the output instead of Body::data,
+         *  which is left empty.
+         */
+        const Output::pointer& output() const { return output_; }
+        /** Body data are written into the output instead of Body::data,
+         *  which is left empty.
+         */
+        Query& output(const Output::pointer &output) {
+            output_ = output; return *this;
+        }
+        /** Query is aborted as soon as possible once the flag is set.
+         *  Aborted query fails with std::errc::operation_canceled.
+         */
+        Query& abortFlag(const AbortFlag &flag) {
+            abortFlag_ = flag; return *this;
+        }
+
         void set(std::time_t lastModified, std::time_t expires
                  , const void *data, std::size_t size
-                 , const std::string &contentType);
+                 , const std::string &contentType
+                 , const std::string &etag = std::string());
 
         void redirect(const std::string &url, std::error_code code);
 
@@ -153,8 +241,11 @@ public:
 
         long long timeout_;
         unsigned long long delay_;
+        unsigned int weight_;
 
         Options options_;
+        AbortFlag abortFlag_;
+        Output::pointer output_;
     };
 
     class MultiQuery : public utility::Supplement<MultiQuery> {
@@ -251,7 +342,7 @@ inline ResourceFetcher::Query::Query(const std::string &location
                                      , bool followRedirects)
     : empty_(false), location_(location), exc_(), ec_()
     , followRedirects_(followRedirects)
-    , reuse_(true), timeout_(-1), delay_()
+    , reuse_(true), timeout_(-1), delay_(), weight_()
 {}
 
 inline void ResourceFetcher::Query::assign(const std::string &location
@@ -268,11 +359,13 @@ inline void ResourceFetcher::Query::assign(const std::string &location
 inline void ResourceFetcher::Query::set(std::time_t lastModified
                                         , std::time_t expires
                                         , const void *data, std::size_t size
-                                        , const std::string &contentType)
+                                        , const std::string &contentType
+                                        , const std::string &etag)
 {
     body_.lastModified = lastModified;
     body_.expires = expires;
     body_.contentType = contentType;
+    body_.etag = etag;
     body_.data.assign(static_cast<const char*>(data), size);
     body_.redirect = std::error_code();
     exc_ = {};
@@ -285,6 +378,7 @@ inline void ResourceFetcher::Query::redirect(const std::string &url
     body_.lastModified = body_.expires = -1;
     body_.data = url;
     body_.contentType.clear();
+    body_.etag.clear();
     body_.redirect = code;
     exc_ = {};
     ec_ = {};
@@ -207,6 +207,26 @@ math::Point2 CsConvertor::operator()(const math::Point2 &p) const
     return (*conv_)(p);
 }
 
+void CsConvertor::operator()(double *points, std::size_t count
+                             , std::size_t stride) const
+{
+    // no conversion needed if no convertor present
+    if (!conv_) { return; }
+
+    const auto adjust([&](const geo::VerticalAdjuster &adjuster, bool inverse)
+    {
+        for (std::size_t i = 0; i < count; ++i) {
+            double *p(points + i * stride);
+            p[2] = adjuster(math::Point3(p[0], p[1], p[2]), inverse)(2);
+        }
+    });
+
+    // un-vert-adjusts -> converts -> vert-adjusts
+    adjust(srcAdjuster_, true);
+    (*conv_)(points, count, stride);
+    adjust(dstAdjuster_, false);
+}
+
 math::Extents3 CsConvertor::operator()(const math::Extents3 &e) const
 {
     math::Extents3 out(math::InvalidExtents{});
@@ -117,6 +117,14 @@ public:
      */
     math::Point2 operator()(const math::Point2 &p) const;
 
+    /** Converts count 3D points in place, same as the Point3 version.
+     *
+     *  The i-th point is at points[i * stride]. All points are passed to the
+     *  underlying geo convertor at once.
+     */
+    void operator()(double *points, std::size_t count
+                    , std::size_t stride = 3) const;
+
     /** Returns bounding box of all 8 corners converted to TO SRS.
      */
     math::Extents3 operator()(const math::Extents3 &e) const;
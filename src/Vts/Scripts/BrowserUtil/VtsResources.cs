@@ -97,6 +97,14 @@ public class VtsTexture : IDisposable
 {
     private static TextureFormat ExtractFormat(vts.Texture t)
     {
+        switch (t.internalFormat)
+        {
+            // block compressed formats (see textureCompression in map create options)
+            case 0x83F0: return TextureFormat.DXT1;
+            case 0x83F3: return TextureFormat.DXT5;
+            case 0x9274: return TextureFormat.ETC2_RGB;
+            case 0x9278: return TextureFormat.ETC2_RGBA8;
+        }
         switch (t.type)
         {
             case GpuType.Byte:
@@ -169,9 +177,27 @@ public class VtsTexture : IDisposable
         if (ut == null)
         {
             Debug.Assert(vt != null);
-            ut = new Texture2D((int)vt.width, (int)vt.height, ExtractFormat(vt), false);
+            bool mipChain = vt.mipmaps != null && vt.mipmaps.Length > 0;
+            ut = new Texture2D((int)vt.width, (int)vt.height, ExtractFormat(vt), mipChain);
             ut.name = id;
-            ut.LoadRawTextureData(vt.data);
+            if (mipChain)
+            {
+                // unity expects all the levels in one buffer
+                int size = vt.data.Length;
+                foreach (var m in vt.mipmaps)
+                    size += m.Length;
+                byte[] all = new byte[size];
+                Buffer.BlockCopy(vt.data, 0, all, 0, vt.data.Length);
+                int offset = vt.data.Length;
+                foreach (var m in vt.mipmaps)
+                {
+                    Buffer.BlockCopy(m, 0, all, offset, m.Length);
+                    offset += m.Length;
+                }
+                ut.LoadRawTextureData(all);
+            }
+            else
+                ut.LoadRawTextureData(vt.data);
             ut.filterMode = ExtractFilterMode(vt.filterMode);
             ut.wrapMode = ExtractWrapMode(vt.wrapMode);
             ut.anisoLevel = 100; // just do it!